@@ -0,0 +1,928 @@
+/*
+  ==============================================================================
+
+    Micro-benchmark for DelayEngine.
+
+    Sweeps block size, channel count, tap count and sample rate, and for each
+    combination reports the cost per sample and how much of the audio callback's
+    time budget is left over. Results can be written as JSON or CSV and compared
+    against a saved baseline, so a slower engine fails the run:
+
+        DrawDelayBenchmark --json > baseline.json
+        DrawDelayBenchmark --baseline baseline.json --tolerance 10
+
+    --storage runs the sweep with the delay line in one of the 16-bit formats, and
+    --noise-report measures what those formats cost in quality instead of time.
+    --modulation runs every tap through the moving-tap kernel, with an LFO that deep.
+    --check-scheduling checks that scheduled tap changes start on exactly the right
+    sample for each block size and rate, and exits with 1 if any don't.
+    --check-kernel checks the multi-tap kernel, in every storage format, against a
+    plain per-tap loop, and exits with 1 if they don't match. It only covers the
+    instruction set it was compiled for (see MultiTapKernel::getInstructionSetName()),
+    so build it once per set - e.g. with -mavx2 -mfma -mf16c, the default SSE2, and
+    on ARM - to cover them all. It also renders a dense pattern with and without
+    the convolver, to check the long taps move over to it without a click or any
+    added latency.
+
+    Built with DRAWDELAY_REALTIME_CHECKS, every block the engine processes is run
+    inside a realtime-safety check (see RealtimeSafety), and anything it trapped
+    fails the run with exit code 3.
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+#include "Engine/DelayEngine.h"
+#include "Engine/RealtimeSafety.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    //==============================================================================
+    struct Config
+    {
+        int blockSize;
+        int numChannels;
+        int numTaps;
+        int sampleRate;
+        DelayLine::SampleFormat storage;
+        TapTable::Interpolation interpolation;
+        float modulationDepthMS;
+
+        // The defaults have no suffix, so baselines saved before there was a choice still match
+        juce::String getKey() const
+        {
+            auto key = juce::String (blockSize) + "/" + juce::String (numChannels) + "/"
+                     + juce::String (numTaps) + "/" + juce::String (sampleRate);
+
+            if (storage != DelayLine::SampleFormat::float32)
+                key << "/" << DelayLine::getSampleFormatName (storage);
+
+            if (interpolation != TapTable::Interpolation::linear)
+                key << "/" << getInterpolationName (interpolation);
+
+            if (modulationDepthMS > 0.0f)
+                key << "/mod" << modulationDepthMS;
+
+            return key;
+        }
+
+        static const char* getInterpolationName (TapTable::Interpolation interpolation) noexcept
+        {
+            switch (interpolation)
+            {
+                case TapTable::Interpolation::none:     return "none";
+                case TapTable::Interpolation::cubic:    return "cubic";
+                case TapTable::Interpolation::linear:
+                default:                                return "linear";
+            }
+        }
+    };
+
+    struct Result
+    {
+        Config config;
+        double nsPerSample;  // Per sample per channel
+        double meanLoad;     // Fractions of the callback's time budget
+        double p99Load;
+        double maxLoad;
+
+        double getHeadroomPercent() const    { return 100.0 * (1.0 - p99Load); }
+    };
+
+    struct Options
+    {
+        juce::Array<int> blockSizes   { 64, 256, 1024 };
+        juce::Array<int> channelCounts{ 1, 2, 8 };
+        juce::Array<int> tapCounts    { 1, 32, 256, 2048 };
+        juce::Array<int> sampleRates  { 48000, 96000 };
+
+        double secondsPerRun = 2.0;
+        float feedback = 0.0f;
+        bool parallel = false;
+        DelayLine::SampleFormat storage = DelayLine::SampleFormat::float32;
+        TapTable::Interpolation interpolation = TapTable::Interpolation::linear;
+        float modulationDepthMS = 0.0f;
+        bool noiseReport = false;
+        bool checkScheduling = false;
+        bool checkKernel = false;
+        bool printJSON = false;
+        juce::File csvFile, baselineFile;
+        double tolerancePercent = 10.0;
+    };
+
+    //==============================================================================
+    // The same pseudo-random pattern every run, spread over most of the engine's range so
+    // long taps (and so the bigger convolution stages) get exercised too
+    void makeTaps (int numTaps, juce::Array<float>& delayTimesMS, juce::Array<float>& delayGains)
+    {
+        juce::Random random (numTaps);
+        auto longestMS = (int) (DelayEngine::maximumDelayTimeS * 1000.0f * 0.8f);
+
+        for (int i = 0; i < numTaps; ++i)
+        {
+            delayTimesMS.add ((float) (1 + random.nextInt (longestMS)));
+            delayGains.add (0.05f + 0.5f * random.nextFloat());
+        }
+    }
+
+    // A second of noise to feed in, looped
+    juce::AudioBuffer<float> makeNoise (int numChannels, int sampleRate)
+    {
+        juce::AudioBuffer<float> source (numChannels, sampleRate);
+        juce::Random random (1);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int i = 0; i < source.getNumSamples(); ++i)
+                source.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+        return source;
+    }
+
+    void prepareEngine (DelayEngine& engine, const Config& config, float feedback)
+    {
+        engine.setSampleFormat (config.storage);
+        engine.setInterpolation (config.interpolation);
+        engine.prepare (config.sampleRate, config.blockSize, config.numChannels);
+
+        juce::Array<float> delayTimesMS;
+        juce::Array<float> delayGains;
+        makeTaps (config.numTaps, delayTimesMS, delayGains);
+        engine.setTaps (delayTimesMS, delayGains, feedback);
+        engine.setModulation (0.5f, config.modulationDepthMS);
+    }
+
+    Result runConfig (const Config& config, const Options& options)
+    {
+        DelayEngine engine;
+
+        if (options.parallel)
+            engine.setWorkerPool (juce::SharedResourcePointer<AudioWorkerPool>().get());
+
+        prepareEngine (engine, config, options.feedback);
+        auto source = makeNoise (config.numChannels, config.sampleRate);
+
+        juce::AudioBuffer<float> buffer (config.numChannels, config.blockSize);
+        int sourcePosition = 0;
+
+        auto processNextBlock = [&]
+        {
+            if (sourcePosition + config.blockSize > source.getNumSamples())
+                sourcePosition = 0;
+
+            for (int channel = 0; channel < config.numChannels; ++channel)
+                buffer.copyFrom (channel, 0, source, channel, sourcePosition, config.blockSize);
+
+            sourcePosition += config.blockSize;
+
+            RealtimeSafety::ScopedRealtimeCheck realtimeCheck;
+
+            auto start = std::chrono::steady_clock::now();
+            engine.process (buffer, 0, config.blockSize);
+            return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now() - start).count();
+        };
+
+        // Warm up until the delay line is full and every convolution stage has seen enough
+        // partitions to take over from the direct taps (the biggest partition is 8192 samples)
+        auto warmUpSamples = (int) (DelayEngine::maximumDelayTimeS * (float) config.sampleRate) + 3 * 8192;
+
+        for (int i = 0; i < warmUpSamples; i += config.blockSize)
+            processNextBlock();
+
+        auto numBlocks = juce::jmax (16, (int) (options.secondsPerRun * config.sampleRate / config.blockSize));
+        std::vector<double> blockTimesNS;
+        blockTimesNS.reserve ((size_t) numBlocks);
+
+        for (int i = 0; i < numBlocks; ++i)
+            blockTimesNS.push_back (processNextBlock());
+
+        auto budgetNS = 1.0e9 * config.blockSize / config.sampleRate;
+        double totalNS = 0.0;
+
+        for (auto t : blockTimesNS)
+            totalNS += t;
+
+        std::sort (blockTimesNS.begin(), blockTimesNS.end());
+        auto p99NS = blockTimesNS[juce::jmin (blockTimesNS.size() - 1, (size_t) (0.99 * (double) blockTimesNS.size()))];
+
+        Result result;
+        result.config = config;
+        result.nsPerSample = totalNS / ((double) numBlocks * config.blockSize * config.numChannels);
+        result.meanLoad = totalNS / numBlocks / budgetNS;
+        result.p99Load = p99NS / budgetNS;
+        result.maxLoad = blockTimesNS.back() / budgetNS;
+        return result;
+    }
+
+    //==============================================================================
+    struct NoiseResult
+    {
+        Config config;
+        double snrDB;          // Compact output against the float engine's, over every channel
+        float maxError;
+        size_t lineBytes, floatLineBytes;
+    };
+
+    // Runs a float engine and a compact one side by side on the same input and taps, and compares their outputs.
+    // The delay line gets filled first, so every tap is reading quantised audio by the time anything is measured.
+    NoiseResult runNoiseConfig (const Config& config, const Options& options)
+    {
+        auto floatConfig = config;
+        floatConfig.storage = DelayLine::SampleFormat::float32;
+
+        DelayEngine reference, compact;
+        prepareEngine (reference, floatConfig, options.feedback);
+        prepareEngine (compact, config, options.feedback);
+
+        auto source = makeNoise (config.numChannels, config.sampleRate);
+        source.applyGain (0.5f); // -6dB, so the taps adding up don't clip the int16 line
+
+        juce::AudioBuffer<float> referenceBuffer (config.numChannels, config.blockSize), compactBuffer (config.numChannels, config.blockSize);
+
+        const int warmUpSamples = (int) (DelayEngine::maximumDelayTimeS * (float) config.sampleRate) + 3 * 8192;
+        const int totalSamples = warmUpSamples + juce::jmax (config.blockSize, (int) (options.secondsPerRun * config.sampleRate));
+        int sourcePosition = 0;
+
+        double signalPower = 0.0, errorPower = 0.0;
+        float maxError = 0.0f;
+
+        for (int done = 0; done < totalSamples; done += config.blockSize)
+        {
+            if (sourcePosition + config.blockSize > source.getNumSamples())
+                sourcePosition = 0;
+
+            for (int channel = 0; channel < config.numChannels; ++channel)
+            {
+                referenceBuffer.copyFrom (channel, 0, source, channel, sourcePosition, config.blockSize);
+                compactBuffer.copyFrom (channel, 0, source, channel, sourcePosition, config.blockSize);
+            }
+
+            sourcePosition += config.blockSize;
+
+            {
+                RealtimeSafety::ScopedRealtimeCheck realtimeCheck;
+                reference.process (referenceBuffer, 0, config.blockSize);
+                compact.process (compactBuffer, 0, config.blockSize);
+            }
+
+            if (done < warmUpSamples)
+                continue;
+
+            for (int channel = 0; channel < config.numChannels; ++channel)
+            {
+                auto* expected = referenceBuffer.getReadPointer (channel);
+                auto* actual = compactBuffer.getReadPointer (channel);
+
+                for (int i = 0; i < config.blockSize; ++i)
+                {
+                    const auto error = actual[i] - expected[i];
+                    signalPower += (double) expected[i] * expected[i];
+                    errorPower += (double) error * error;
+                    maxError = juce::jmax (maxError, std::abs (error));
+                }
+            }
+        }
+
+        NoiseResult result;
+        result.config = config;
+        result.snrDB = errorPower > 0.0 ? 10.0 * std::log10 (signalPower / errorPower) : std::numeric_limits<double>::infinity();
+        result.maxError = maxError;
+        result.lineBytes = compact.getDelayLineSizeInBytes();
+        result.floatLineBytes = reference.getDelayLineSizeInBytes();
+        return result;
+    }
+
+    int runNoiseReport (const Options& options)
+    {
+        juce::Array<DelayLine::SampleFormat> formats;
+
+        if (options.storage != DelayLine::SampleFormat::float32)
+            formats.add (options.storage);
+        else
+            formats.addArray ({ DelayLine::SampleFormat::float16, DelayLine::SampleFormat::int16 });
+
+        auto toMB = [] (size_t bytes)    { return juce::String ((double) bytes / (1024.0 * 1024.0), 2) + " MB"; };
+
+        for (auto sampleRate : options.sampleRates)
+            for (auto numTaps : options.tapCounts)
+                for (auto format : formats)
+                {
+                    auto result = runNoiseConfig ({ options.blockSizes.getFirst(), options.channelCounts.getFirst(), numTaps, sampleRate, format,
+                                                     options.interpolation, options.modulationDepthMS }, options);
+
+                    std::cout << result.config.getKey().paddedRight (' ', 28)
+                              << juce::String (result.snrDB, 1).paddedLeft (' ', 8) << " dB SNR"
+                              << juce::String (result.maxError, 6).paddedLeft (' ', 11) << " max error"
+                              << toMB (result.lineBytes).paddedLeft (' ', 11) << " line (float32 "
+                              << toMB (result.floatLineBytes) << ")" << std::endl;
+                }
+
+        return 0;
+    }
+
+    //==============================================================================
+    // What a tap at index reads from a one-channel line, as a float
+    float readLine (const DelayLine& line, int index)
+    {
+        switch (line.getSampleFormat())
+        {
+            case DelayLine::SampleFormat::float16:   return CompactSamples::toFloat (line.getHalfReadPointer (0)[index]);
+            case DelayLine::SampleFormat::int16:     return CompactSamples::toFloat (line.getInt16ReadPointer (0)[index]);
+            case DelayLine::SampleFormat::float32:
+            default:                                 return line.getReadPointer (0)[index];
+        }
+    }
+
+    void addTapsFromLine (float* output, int numSamples, const DelayLine& line, int readOrigin, const int* delays, const float* gains, int numTaps)
+    {
+        switch (line.getSampleFormat())
+        {
+            case DelayLine::SampleFormat::float16:
+                MultiTapKernel::addTaps (output, numSamples, line.getHalfReadPointer (0), line.getMask(), readOrigin, delays, gains, numTaps);
+                break;
+
+            case DelayLine::SampleFormat::int16:
+                MultiTapKernel::addTaps (output, numSamples, line.getInt16ReadPointer (0), line.getMask(), readOrigin, delays, gains, numTaps);
+                break;
+
+            case DelayLine::SampleFormat::float32:
+            default:
+                MultiTapKernel::addTaps (output, numSamples, line.getReadPointer (0), line.getMask(), readOrigin, delays, gains, numTaps);
+                break;
+        }
+    }
+
+    // The kernel against the loop it replaced - one tap at a time over the whole block, wrapping round the ring by hand
+    // rather than reading through the guard region. Tap and sample counts that don't fill a register or a chunk, and
+    // taps that wrap part way through one, are all covered.
+    int runKernelCheck()
+    {
+        constexpr int maximumBlockSize = 256;
+        int numFailures = 0;
+        juce::Random random (2);
+
+        for (auto format : { DelayLine::SampleFormat::float32, DelayLine::SampleFormat::float16, DelayLine::SampleFormat::int16 })
+        {
+            DelayLine line (1, 4096, maximumBlockSize, false, format);
+            const int length = line.getLength();
+
+            // Noise all the way round, a block at a time so the guard region gets mirrored as it goes
+            std::vector<float> block ((size_t) maximumBlockSize);
+
+            for (int position = 0; position < length; position += maximumBlockSize)
+            {
+                for (auto& sample : block)
+                    sample = random.nextFloat() * 2.0f - 1.0f;
+
+                line.write (0, position, block.data(), maximumBlockSize);
+            }
+
+            int numCases = 0, numMismatches = 0;
+            float maxError = 0.0f;
+            juce::String firstMismatch;
+
+            for (int numTaps : { 1, 3, 5, 8, 13, 33, 100 })
+            {
+                for (int numSamples : { 1, 7, 31, 32, 33, 100, maximumBlockSize })
+                {
+                    for (int trial = 0; trial < 8; ++trial)
+                    {
+                        const int readOrigin = random.nextInt (length);
+                        std::vector<int> delays;
+                        std::vector<float> gains;
+                        float totalGain = 0.0f;
+
+                        for (int t = 0; t < numTaps; ++t)
+                        {
+                            // Every other tap starts just before the end of the ring, so it wraps part way through the block
+                            const int start = t % 2 == 0 ? length - 1 - random.nextInt (juce::jmax (1, numSamples - 1))
+                                                         : random.nextInt (length);
+
+                            delays.push_back ((readOrigin - start) & line.getMask());
+                            gains.push_back (random.nextFloat() * 2.0f - 1.0f);
+                            totalGain += std::abs (gains.back());
+                        }
+
+                        std::vector<float> expected ((size_t) numSamples);
+
+                        for (auto& sample : expected)
+                            sample = random.nextFloat() * 2.0f - 1.0f;
+
+                        auto actual = expected;
+
+                        for (int t = 0; t < numTaps; ++t)
+                            for (int i = 0; i < numSamples; ++i)
+                                expected[(size_t) i] += readLine (line, (readOrigin - delays[(size_t) t] + i) & line.getMask()) * gains[(size_t) t];
+
+                        addTapsFromLine (actual.data(), numSamples, line, readOrigin, delays.data(), gains.data(), numTaps);
+
+                        // Only rounding, which FMA and the int16 scale folded into the gains can change
+                        const float tolerance = 1.0e-5f * (1.0f + totalGain);
+                        float caseError = 0.0f;
+
+                        for (int i = 0; i < numSamples; ++i)
+                            caseError = juce::jmax (caseError, std::abs (actual[(size_t) i] - expected[(size_t) i]));
+
+                        maxError = juce::jmax (maxError, caseError);
+                        ++numCases;
+
+                        if (caseError > tolerance)
+                        {
+                            if (numMismatches++ == 0)
+                                firstMismatch = juce::String (numTaps) + " taps, " + juce::String (numSamples) + " samples, off by " + juce::String (caseError);
+                        }
+                    }
+                }
+            }
+
+            std::cout << (juce::String (MultiTapKernel::getInstructionSetName()) + " " + DelayLine::getSampleFormatName (format)).paddedRight (' ', 28);
+
+            if (numMismatches == 0)
+            {
+                std::cout << numCases << " cases match the per-tap loop, max error " << maxError << std::endl;
+            }
+            else
+            {
+                std::cout << "FAILED: " << numMismatches << " of " << numCases << " cases differ from the per-tap loop, first "
+                          << firstMismatch << std::endl;
+                ++numFailures;
+            }
+        }
+
+        return numFailures > 0 ? 1 : 0;
+    }
+
+    //==============================================================================
+    // Renders a second of noise, looped, through an engine that's already been set up
+    juce::AudioBuffer<float> renderNoise (DelayEngine& engine, int sampleRate, int blockSize, int numSamples)
+    {
+        auto source = makeNoise (1, sampleRate);
+        juce::AudioBuffer<float> output (1, numSamples);
+        output.clear();
+
+        for (int done = 0; done < numSamples; done += blockSize)
+        {
+            const int num = juce::jmin (blockSize, numSamples - done);
+
+            // A block that spans the end of the noise carries on from its start
+            for (int copied = 0; copied < num;)
+            {
+                const int sourceStart = (done + copied) % sampleRate;
+                const int pieceLength = juce::jmin (num - copied, sampleRate - sourceStart);
+
+                output.copyFrom (0, done + copied, source, 0, sourceStart, pieceLength);
+                copied += pieceLength;
+            }
+
+            RealtimeSafety::ScopedRealtimeCheck realtimeCheck;
+            engine.process (output, done, num);
+        }
+
+        return output;
+    }
+
+    // Three single-tap tables: the first from the start, and the other two scheduled at firstChange and secondChange
+    juce::AudioBuffer<float> renderScheduledChanges (int sampleRate, int blockSize, juce::int64 firstChange, juce::int64 secondChange, int numSamples)
+    {
+        DelayEngine engine;
+        engine.setInterpolation (TapTable::Interpolation::none);
+        engine.prepare (sampleRate, blockSize, 1);
+        engine.setTaps (juce::Array<float> { 100.0f }, juce::Array<float> { 0.5f }, 0.0f);
+        engine.scheduleTaps (engine.createTapTable ({ 200.0f }, { 0.5f }), firstChange);
+        engine.scheduleTaps (engine.createTapTable ({ 300.0f }, { 0.5f }), secondChange);
+
+        return renderNoise (engine, sampleRate, blockSize, numSamples);
+    }
+
+    // Two changes less than a crossfade apart, the first just before a block boundary: the second one falls due
+    // while the first is still fading across that boundary, and has to start on exactly the sample the fade ends
+    int runSchedulingCheck (const Options& options)
+    {
+        int numFailures = 0;
+
+        for (auto sampleRate : options.sampleRates)
+        {
+            for (auto blockSize : options.blockSizes)
+            {
+                const int fadeLength = juce::jmax (1, juce::roundToInt (DelayEngine::crossfadeTimeS * (float) sampleRate));
+
+                // Over a second in, so every tap has something to read
+                const auto boundary = (juce::int64) (sampleRate / blockSize + 2) * blockSize;
+                const auto firstChange = boundary - juce::jmax (1, juce::jmin (blockSize, fadeLength) / 4);
+                const auto secondChange = firstChange + fadeLength / 2;
+                const int numSamples = (int) boundary + 2 * fadeLength + 2 * blockSize;
+
+                auto actual = renderScheduledChanges (sampleRate, blockSize, firstChange, secondChange, numSamples);
+                auto expected = renderScheduledChanges (sampleRate, blockSize, firstChange, firstChange + fadeLength, numSamples);
+
+                int firstDifference = -1;
+
+                for (int i = 0; i < numSamples && firstDifference < 0; ++i)
+                    if (std::abs (actual.getSample (0, i) - expected.getSample (0, i)) > 1.0e-6f)
+                        firstDifference = i;
+
+                std::cout << (juce::String (blockSize) + "/" + juce::String (sampleRate)).paddedRight (' ', 28);
+
+                if (firstDifference < 0)
+                {
+                    std::cout << "second change starts at the end of the fade, sample " << firstChange + fadeLength << std::endl;
+                }
+                else
+                {
+                    std::cout << "FAILED: output differs from sample " << firstDifference
+                              << ", the fade ends at " << firstChange + fadeLength << std::endl;
+                    ++numFailures;
+                }
+            }
+        }
+
+        return numFailures > 0 ? 1 : 0;
+    }
+
+    // The densest pattern the sweep uses, rendered twice: as it comes, so its long taps move over to the convolver as each
+    // stage gets ready, and with the convolution taken out so every tap stays on the direct kernel. The two have to match
+    // all the way through - a click at the handover, or any latency in the convolver, would show up as a difference.
+    int runConvolutionCheck (const Options& options)
+    {
+        constexpr int numTaps = 2048;
+        int numFailures = 0;
+
+        juce::Array<float> delayTimesMS;
+        juce::Array<float> delayGains;
+        makeTaps (numTaps, delayTimesMS, delayGains);
+
+        float totalGain = 0.0f;
+
+        for (auto gain : delayGains)
+            totalGain += std::abs (gain);
+
+        for (auto sampleRate : options.sampleRates)
+        {
+            for (auto blockSize : options.blockSizes)
+            {
+                DelayEngine convolving, direct;
+
+                for (auto* engine : { &convolving, &direct })
+                {
+                    engine->setInterpolation (TapTable::Interpolation::none);
+                    engine->prepare (sampleRate, blockSize, 1);
+                }
+
+                auto convolvingTable = convolving.createTapTable (delayTimesMS, delayGains);
+                auto directTable = direct.createTapTable (delayTimesMS, delayGains);
+                directTable->convolution.reset();
+
+                std::cout << (juce::String (blockSize) + "/" + juce::String (sampleRate)).paddedRight (' ', 28);
+
+                if (convolvingTable->convolution == nullptr)
+                {
+                    std::cout << "FAILED: " << numTaps << " taps aren't dense enough to be convolved" << std::endl;
+                    ++numFailures;
+                    continue;
+                }
+
+                convolving.setTaps (convolvingTable);
+                direct.setTaps (directTable);
+
+                // A stage is ready once it's seen a whole delay line's worth of partitions (and two more), counted
+                // from the first block - then a second more, so every stage has been convolving for a while
+                int readyAt = 0;
+
+                for (auto& stage : PartitionedConvolver::createLayout ((int) (DelayEngine::maximumDelayTimeS * (float) sampleRate)))
+                    readyAt = juce::jmax (readyAt, (stage.numPartitions + 2) * stage.partitionSize + blockSize);
+
+                const int numSamples = readyAt + sampleRate;
+
+                auto actual = renderNoise (convolving, sampleRate, blockSize, numSamples);
+                auto expected = renderNoise (direct, sampleRate, blockSize, numSamples);
+
+                float warmingUpError = 0.0f, readyError = 0.0f;
+                int worstSample = 0;
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const float error = std::abs (actual.getSample (0, i) - expected.getSample (0, i));
+                    auto& phaseError = i < readyAt ? warmingUpError : readyError;
+
+                    if (error > juce::jmax (warmingUpError, readyError))
+                        worstSample = i;
+
+                    phaseError = juce::jmax (phaseError, error);
+                }
+
+                // Only rounding, which the FFTs add more of the more taps there are
+                const float tolerance = 1.0e-5f * (1.0f + totalGain);
+
+                if (juce::jmax (warmingUpError, readyError) > tolerance)
+                {
+                    std::cout << "FAILED: off by " << juce::jmax (warmingUpError, readyError) << " at sample " << worstSample
+                              << ", the stages are ready by " << readyAt << std::endl;
+                    ++numFailures;
+                }
+                else if (readyError == 0.0f)
+                {
+                    // The FFTs never round exactly the same way as the kernel, so identical output means they never ran
+                    std::cout << "FAILED: the convolver never took over from the direct path" << std::endl;
+                    ++numFailures;
+                }
+                else
+                {
+                    std::cout << "direct and convolved match, max error " << warmingUpError << " warming up, "
+                              << readyError << " once the stages are ready" << std::endl;
+                }
+            }
+        }
+
+        return numFailures > 0 ? 1 : 0;
+    }
+
+    //==============================================================================
+    juce::var toVar (const Result& result)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty ("key", result.config.getKey());
+        object->setProperty ("blockSize", result.config.blockSize);
+        object->setProperty ("numChannels", result.config.numChannels);
+        object->setProperty ("numTaps", result.config.numTaps);
+        object->setProperty ("sampleRate", result.config.sampleRate);
+        object->setProperty ("storage", DelayLine::getSampleFormatName (result.config.storage));
+        object->setProperty ("interpolation", Config::getInterpolationName (result.config.interpolation));
+        object->setProperty ("modulationDepthMS", result.config.modulationDepthMS);
+        object->setProperty ("nsPerSample", result.nsPerSample);
+        object->setProperty ("meanLoad", result.meanLoad);
+        object->setProperty ("p99Load", result.p99Load);
+        object->setProperty ("maxLoad", result.maxLoad);
+        object->setProperty ("headroomPercent", result.getHeadroomPercent());
+        return juce::var (object);
+    }
+
+    juce::String toCSV (const juce::Array<Result>& results)
+    {
+        juce::String csv ("blockSize,numChannels,numTaps,sampleRate,storage,interpolation,modulationDepthMS,"
+                          "nsPerSample,meanLoad,p99Load,maxLoad,headroomPercent\n");
+
+        for (auto& r : results)
+            csv << r.config.blockSize << "," << r.config.numChannels << "," << r.config.numTaps << ","
+                << r.config.sampleRate << "," << DelayLine::getSampleFormatName (r.config.storage) << ","
+                << Config::getInterpolationName (r.config.interpolation) << "," << r.config.modulationDepthMS << ","
+                << r.nsPerSample << "," << r.meanLoad << ","
+                << r.p99Load << "," << r.maxLoad << "," << r.getHeadroomPercent() << "\n";
+
+        return csv;
+    }
+
+    // Returns the number of configurations that got slower than the baseline allows
+    int compareWithBaseline (const juce::Array<Result>& results, const juce::File& baselineFile, double tolerancePercent)
+    {
+        auto baseline = juce::JSON::parse (baselineFile);
+
+        if (! baseline.isArray())
+        {
+            std::cerr << "Couldn't read a baseline from " << baselineFile.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        int numRegressions = 0;
+
+        for (auto& r : results)
+        {
+            for (auto& entry : *baseline.getArray())
+            {
+                if (entry["key"].toString() != r.config.getKey())
+                    continue;
+
+                auto baselineNS = (double) entry["nsPerSample"];
+                auto allowedNS = baselineNS * (1.0 + tolerancePercent / 100.0);
+
+                if (r.nsPerSample > allowedNS)
+                {
+                    std::cerr << "REGRESSION " << r.config.getKey() << ": " << r.nsPerSample
+                              << " ns/sample, baseline " << baselineNS << std::endl;
+                    ++numRegressions;
+                }
+            }
+        }
+
+        return numRegressions;
+    }
+
+    //==============================================================================
+    juce::Array<int> parseList (const juce::String& text)
+    {
+        juce::Array<int> values;
+
+        for (auto& token : juce::StringArray::fromTokens (text, ",", {}))
+            if (token.getIntValue() > 0)
+                values.add (token.getIntValue());
+
+        return values;
+    }
+
+    juce::Result parseCommandLine (const juce::StringArray& args, Options& options)
+    {
+        auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+
+        for (int i = 0; i < args.size(); ++i)
+        {
+            auto arg = args[i];
+            auto nextValue = [&] { return i + 1 < args.size() ? args[++i].unquoted() : juce::String(); };
+
+            if (arg == "--json")
+            {
+                options.printJSON = true;
+            }
+            else if (arg == "--csv")
+            {
+                options.csvFile = workingDirectory.getChildFile (nextValue());
+            }
+            else if (arg == "--baseline")
+            {
+                options.baselineFile = workingDirectory.getChildFile (nextValue());
+            }
+            else if (arg == "--tolerance")
+            {
+                options.tolerancePercent = juce::jmax (0.0, nextValue().getDoubleValue());
+            }
+            else if (arg == "--seconds")
+            {
+                options.secondsPerRun = juce::jmax (0.05, nextValue().getDoubleValue());
+            }
+            else if (arg == "--feedback")
+            {
+                options.feedback = juce::jlimit (0.0f, TapTable::maximumFeedback, nextValue().getFloatValue());
+            }
+            else if (arg == "--parallel")
+            {
+                options.parallel = true;
+            }
+            else if (arg == "--storage")
+            {
+                auto name = nextValue();
+
+                if (name == "float32")        options.storage = DelayLine::SampleFormat::float32;
+                else if (name == "float16")   options.storage = DelayLine::SampleFormat::float16;
+                else if (name == "int16")     options.storage = DelayLine::SampleFormat::int16;
+                else                          return juce::Result::fail ("Unknown storage format: " + name);
+            }
+            else if (arg == "--noise-report")
+            {
+                options.noiseReport = true;
+            }
+            else if (arg == "--check-scheduling")
+            {
+                options.checkScheduling = true;
+            }
+            else if (arg == "--check-kernel")
+            {
+                options.checkKernel = true;
+            }
+            else if (arg == "--interpolation")
+            {
+                auto name = nextValue();
+
+                if (name == "none")          options.interpolation = TapTable::Interpolation::none;
+                else if (name == "linear")   options.interpolation = TapTable::Interpolation::linear;
+                else if (name == "cubic")    options.interpolation = TapTable::Interpolation::cubic;
+                else                         return juce::Result::fail ("Unknown interpolation: " + name);
+            }
+            else if (arg == "--modulation")
+            {
+                options.modulationDepthMS = juce::jlimit (0.0f, DelayEngine::maximumModulationDepthMS, nextValue().getFloatValue());
+            }
+            else if (arg == "--quick")
+            {
+                options.blockSizes = { 256 };
+                options.channelCounts = { 2 };
+                options.tapCounts = { 1, 256 };
+                options.sampleRates = { 48000 };
+                options.secondsPerRun = 0.5;
+            }
+            else if (arg == "--full")
+            {
+                options.blockSizes = { 32, 64, 128, 256, 512, 1024, 2048 };
+                options.channelCounts = { 1, 2, 4, 8, 16 };
+                options.tapCounts = { 1, 4, 16, 32, 64, 256, 1024, 2048, 4096 };
+                options.sampleRates = { 44100, 48000, 96000, 192000 };
+            }
+            else if (arg == "--blocks")   options.blockSizes = parseList (nextValue());
+            else if (arg == "--channels") options.channelCounts = parseList (nextValue());
+            else if (arg == "--taps")     options.tapCounts = parseList (nextValue());
+            else if (arg == "--rates")    options.sampleRates = parseList (nextValue());
+            else
+            {
+                return juce::Result::fail ("Unknown option: " + arg);
+            }
+        }
+
+        if (options.blockSizes.isEmpty() || options.channelCounts.isEmpty()
+             || options.tapCounts.isEmpty() || options.sampleRates.isEmpty())
+            return juce::Result::fail ("Every sweep needs at least one value");
+
+        return juce::Result::ok();
+    }
+
+    // Anything the checks trapped fails the run, unless it's already failing for another reason
+    int checkRealtimeSafety (int exitCode)
+    {
+        const int numViolations = RealtimeSafety::getNumViolations();
+
+        if (numViolations == 0)
+            return exitCode;
+
+        std::cerr << numViolations << " realtime-safety violation(s) while processing" << std::endl;
+        return exitCode != 0 ? exitCode : 3;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Usage: DrawDelayBenchmark [--quick | --full] [--blocks 64,256] [--channels 1,2]\n"
+                     "                          [--taps 1,32] [--rates 48000] [--feedback 0.5] [--seconds 2]\n"
+                     "                          [--parallel] [--storage float32|float16|int16] [--noise-report]\n"
+                     "                          [--check-scheduling] [--check-kernel]\n"
+                     "                          [--interpolation none|linear|cubic] [--modulation <ms>]\n"
+                     "                          [--json] [--csv results.csv]\n"
+                     "                          [--baseline baseline.json [--tolerance 10]]" << std::endl;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add (argv[i]);
+
+    Options options;
+    auto parsed = parseCommandLine (args, options);
+
+    if (parsed.failed())
+    {
+        std::cerr << parsed.getErrorMessage() << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    if (options.noiseReport)
+        return checkRealtimeSafety (runNoiseReport (options));
+
+    if (options.checkScheduling)
+        return checkRealtimeSafety (runSchedulingCheck (options));
+
+    if (options.checkKernel)
+        return checkRealtimeSafety (juce::jmax (runKernelCheck(), runConvolutionCheck (options)));
+
+    // Held for the whole run, so the worker threads aren't restarted for every configuration
+    juce::SharedResourcePointer<AudioWorkerPool> workerPool;
+    juce::Array<Result> results;
+
+    for (auto sampleRate : options.sampleRates)
+        for (auto blockSize : options.blockSizes)
+            for (auto numChannels : options.channelCounts)
+                for (auto numTaps : options.tapCounts)
+                {
+                    auto result = runConfig ({ blockSize, numChannels, numTaps, sampleRate, options.storage,
+                                               options.interpolation, options.modulationDepthMS }, options);
+                    results.add (result);
+
+                    // The table goes to stderr when stdout is carrying the JSON
+                    auto& table = options.printJSON ? std::cerr : std::cout;
+                    table << result.config.getKey().paddedRight (' ', 28)
+                          << juce::String (result.nsPerSample, 2).paddedLeft (' ', 10) << " ns/sample"
+                          << juce::String (100.0 * result.meanLoad, 2).paddedLeft (' ', 9) << "% mean"
+                          << juce::String (100.0 * result.p99Load, 2).paddedLeft (' ', 9) << "% p99"
+                          << juce::String (result.getHeadroomPercent(), 1).paddedLeft (' ', 8) << "% headroom"
+                          << std::endl;
+                }
+
+    if (options.printJSON)
+    {
+        juce::Array<juce::var> entries;
+
+        for (auto& r : results)
+            entries.add (toVar (r));
+
+        std::cout << juce::JSON::toString (juce::var (entries)) << std::endl;
+    }
+
+    if (options.csvFile != juce::File() && ! options.csvFile.replaceWithText (toCSV (results)))
+    {
+        std::cerr << "Couldn't write " << options.csvFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    if (options.baselineFile != juce::File())
+    {
+        auto numRegressions = compareWithBaseline (results, options.baselineFile, options.tolerancePercent);
+
+        if (numRegressions > 0)
+        {
+            std::cerr << numRegressions << " configuration(s) slower than the baseline allows" << std::endl;
+            return 2;
+        }
+    }
+
+    return checkRealtimeSafety (0);
+}
@@ -0,0 +1,452 @@
+/*
+  ==============================================================================
+
+    Headless host for the Draw Delay plugin.
+
+    Runs the processor the way a host would - through juce::AudioProcessor only -
+    and checks what a host relies on:
+
+        - the latency it reports is what it really has (none)
+        - any sequence of block sizes up to the prepared maximum gives the same
+          output as a fixed one, sample for sample
+        - bypass passes the input straight through
+        - the reported tail covers everything the taps still play once the input stops
+
+    Then it loads lots of instances at once, each with its own taps, and reports
+    the CPU time and memory each one costs:
+
+        DrawDelayPluginHost --instances 500 --seconds 5
+        DrawDelayPluginHost --vst3 build/DrawDelayPlugin_artefacts/Release/VST3/Draw\ Delay.vst3
+
+    By default the processor is built into this program; --vst3 loads the real
+    plugin binary instead. A failed check exits with 1, and (as with the engine
+    benchmark) anything DRAWDELAY_REALTIME_CHECKS trapped exits with 3.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "Plugin/DrawDelayProcessor.h"
+#include "Engine/RealtimeSafety.h"
+
+#include <cstdio>
+#include <iostream>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    //==============================================================================
+    struct Options
+    {
+        int numInstances = 200;
+        double seconds = 2.0;
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        juce::File vst3File; // Empty to use the processor built in
+    };
+
+    // Every instance is given this, with its own taps spread out so no two are alike
+    TapPattern makePattern (int instance)
+    {
+        TapPattern pattern;
+        pattern.name = "Instance " + juce::String (instance);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            pattern.delayTimesMS.add (20.0f + (float) ((instance * 37 + i * 113) % 1500));
+            pattern.delayGains.add (0.6f / (float) (i + 1));
+        }
+
+        return pattern;
+    }
+
+    //==============================================================================
+    class InstanceFactory
+    {
+    public:
+        explicit InstanceFactory (const Options& o) : options (o)
+        {
+            formatManager.addDefaultFormats();
+        }
+
+        juce::Result initialise()
+        {
+            if (options.vst3File == juce::File())
+                return juce::Result::ok();
+
+           #if JUCE_PLUGINHOST_VST3
+            juce::VST3PluginFormat format;
+            juce::OwnedArray<juce::PluginDescription> types;
+            format.findAllTypesForFile (types, options.vst3File.getFullPathName());
+
+            if (types.isEmpty())
+                return juce::Result::fail ("No plugin found in " + options.vst3File.getFullPathName());
+
+            description = *types.getFirst();
+            return juce::Result::ok();
+           #else
+            return juce::Result::fail ("This build can't host VST3s");
+           #endif
+        }
+
+        std::unique_ptr<juce::AudioProcessor> create()
+        {
+            if (options.vst3File == juce::File())
+                return std::make_unique<DrawDelayProcessor>();
+
+            juce::String error;
+            auto instance = formatManager.createPluginInstance (description, options.sampleRate, options.blockSize, error);
+
+            if (instance == nullptr)
+                std::cerr << "Couldn't load " << options.vst3File.getFullPathName() << ": " << error << std::endl;
+
+            return instance;
+        }
+
+    private:
+        const Options& options;
+        juce::AudioPluginFormatManager formatManager;
+        juce::PluginDescription description;
+    };
+
+    //==============================================================================
+    // A loaded plugin only takes the taps as state, so they go in the same way for both
+    void setPattern (juce::AudioProcessor& processor, const TapPattern& pattern)
+    {
+        DrawDelayProcessor stateMaker;
+        stateMaker.setTapPattern (pattern);
+
+        juce::MemoryBlock state;
+        stateMaker.getStateInformation (state);
+        processor.setStateInformation (state.getData(), (int) state.getSize());
+    }
+
+    void prepare (juce::AudioProcessor& processor, const Options& options)
+    {
+        processor.setPlayConfigDetails (2, 2, options.sampleRate, options.blockSize);
+        processor.prepareToPlay (options.sampleRate, options.blockSize);
+    }
+
+    void setBypassed (juce::AudioProcessor& processor, bool shouldBeBypassed)
+    {
+        if (auto* parameter = processor.getBypassParameter())
+            parameter->setValueNotifyingHost (shouldBeBypassed ? 1.0f : 0.0f);
+    }
+
+    // Runs a whole buffer through in blocks of the given sizes, over and over until it's done
+    void processInBlocks (juce::AudioProcessor& processor, juce::AudioBuffer<float>& audio, const juce::Array<int>& blockSizes)
+    {
+        juce::MidiBuffer midi;
+
+        for (int position = 0, i = 0; position < audio.getNumSamples(); ++i)
+        {
+            const int numSamples = juce::jmin (blockSizes[i % blockSizes.size()], audio.getNumSamples() - position);
+            juce::AudioBuffer<float> block (audio.getArrayOfWritePointers(), audio.getNumChannels(), position, numSamples);
+
+            {
+                RealtimeSafety::ScopedRealtimeCheck realtimeCheck;
+                processor.processBlock (block, midi);
+            }
+
+            position += numSamples;
+        }
+    }
+
+    juce::AudioBuffer<float> makeNoise (int numSamples, int seed)
+    {
+        juce::AudioBuffer<float> noise (2, numSamples);
+        juce::Random random (seed);
+
+        for (int channel = 0; channel < noise.getNumChannels(); ++channel)
+            for (int i = 0; i < numSamples; ++i)
+                noise.setSample (channel, i, random.nextFloat() * 0.5f - 0.25f);
+
+        return noise;
+    }
+
+    float getLargestDifference (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        float largest = 0.0f;
+
+        for (int channel = 0; channel < a.getNumChannels(); ++channel)
+            for (int i = 0; i < a.getNumSamples(); ++i)
+                largest = juce::jmax (largest, std::abs (a.getSample (channel, i) - b.getSample (channel, i)));
+
+        return largest;
+    }
+
+    //==============================================================================
+    int numFailures = 0;
+
+    void check (bool passed, const juce::String& what)
+    {
+        std::cout << (passed ? "  pass  " : "  FAIL  ") << what << std::endl;
+
+        if (! passed)
+            ++numFailures;
+    }
+
+    void runHostChecks (InstanceFactory& factory, const Options& options)
+    {
+        std::cout << "Host checks" << std::endl;
+
+        if (factory.create() == nullptr)
+        {
+            check (false, "plugin loads");
+            return;
+        }
+
+        const auto pattern = makePattern (0);
+        const int length = (int) (options.sampleRate * 2.0);
+
+        // Latency: an impulse comes back out at exactly the first tap's time, with nothing added
+        {
+            auto processor = factory.create();
+            setPattern (*processor, pattern);
+            prepare (*processor, options);
+
+            juce::AudioBuffer<float> audio (2, length);
+            audio.clear();
+            audio.setSample (0, 0, 1.0f);
+            audio.setSample (1, 0, 1.0f);
+
+            processInBlocks (*processor, audio, { options.blockSize });
+
+            const int firstTap = juce::roundToInt (pattern.delayTimesMS.getFirst() * options.sampleRate / 1000.0);
+            int firstEcho = 1;
+
+            while (firstEcho < length && std::abs (audio.getSample (0, firstEcho)) < 1.0e-6f)
+                ++firstEcho;
+
+            check (processor->getLatencySamples() == 0, "reports no latency");
+            check (audio.getSample (0, 0) == 1.0f && std::abs (firstEcho - firstTap) <= 1,
+                   "first echo at " + juce::String (firstEcho) + " samples, tap at " + juce::String (firstTap));
+        }
+
+        // Block sizes: the output mustn't depend on how the host slices the audio
+        {
+            auto reference = factory.create();
+            auto varying = factory.create();
+
+            for (auto* processor : { reference.get(), varying.get() })
+            {
+                setPattern (*processor, pattern);
+                prepare (*processor, options);
+            }
+
+            auto expected = makeNoise (length, 1);
+            auto actual = makeNoise (length, 1);
+
+            processInBlocks (*reference, expected, { options.blockSize });
+            processInBlocks (*varying, actual, { 1, options.blockSize, 17, 3, options.blockSize / 2, 64, options.blockSize - 1, 5 });
+
+            const auto difference = getLargestDifference (expected, actual);
+            check (difference < 1.0e-5f, "varying block sizes match a fixed one (largest difference " + juce::String (difference) + ")");
+        }
+
+        // Bypass: the input comes out untouched, and the echoes come back once it's switched off again
+        {
+            auto processor = factory.create();
+            setPattern (*processor, pattern);
+            prepare (*processor, options);
+
+            const auto input = makeNoise (length, 2);
+            auto audio = input;
+
+            check (processor->getBypassParameter() != nullptr, "has a bypass parameter");
+
+            setBypassed (*processor, true);
+            processInBlocks (*processor, audio, { options.blockSize });
+            check (getLargestDifference (audio, input) == 0.0f, "bypassed output is the input");
+
+            setBypassed (*processor, false);
+            audio = input;
+            processInBlocks (*processor, audio, { options.blockSize });
+            check (getLargestDifference (audio, input) > 0.0f, "echoes again once bypass is off");
+        }
+
+        // Tail: whatever's still sounding when the reported tail ends is 60dB below the echoes
+        {
+            auto processor = factory.create();
+            auto tailPattern = pattern;
+            tailPattern.feedback = 0.5f;
+            setPattern (*processor, tailPattern);
+            prepare (*processor, options);
+
+            const double tailSeconds = processor->getTailLengthSeconds();
+            const int inputLength = (int) options.sampleRate;
+            const int tailLength = (int) std::ceil (tailSeconds * options.sampleRate);
+
+            auto audio = makeNoise (inputLength + tailLength + options.blockSize, 3);
+
+            for (int channel = 0; channel < audio.getNumChannels(); ++channel)
+                audio.clear (channel, inputLength, audio.getNumSamples() - inputLength);
+
+            processInBlocks (*processor, audio, { options.blockSize });
+
+            const auto peak = audio.getMagnitude (0, inputLength);
+            const auto leftOver = audio.getMagnitude (inputLength + tailLength, options.blockSize);
+
+            const auto longestTapMS = juce::FloatVectorOperations::findMaximum (tailPattern.delayTimesMS.begin(), tailPattern.size());
+
+            check (tailSeconds * 1000.0 >= longestTapMS, "tail of " + juce::String (tailSeconds, 2) + "s covers the taps");
+            check (leftOver <= peak * 0.001f, "nothing louder than -60dB after the tail");
+        }
+    }
+
+    //==============================================================================
+    // Resident memory, for working out what each instance costs
+    juce::int64 getResidentBytes()
+    {
+       #if JUCE_LINUX
+        long size = 0, resident = 0;
+
+        if (auto* statm = std::fopen ("/proc/self/statm", "r"))
+        {
+            if (std::fscanf (statm, "%ld %ld", &size, &resident) != 2)
+                resident = 0;
+
+            std::fclose (statm);
+        }
+
+        return (juce::int64) resident * (juce::int64) sysconf (_SC_PAGESIZE);
+       #else
+        return 0;
+       #endif
+    }
+
+    void runManyInstances (InstanceFactory& factory, const Options& options)
+    {
+        std::cout << "Running " << options.numInstances << " instances" << std::endl;
+
+        const auto residentBefore = getResidentBytes();
+        std::vector<std::unique_ptr<juce::AudioProcessor>> instances;
+
+        for (int i = 0; i < options.numInstances; ++i)
+        {
+            auto instance = factory.create();
+
+            if (instance == nullptr)
+                break;
+
+            setPattern (*instance, makePattern (i));
+            prepare (*instance, options);
+            instances.push_back (std::move (instance));
+        }
+
+        const auto residentAfterLoading = getResidentBytes();
+
+        // Round-robin, one block each, as a host's graph would - every instance gets the same input
+        const auto input = makeNoise (options.blockSize, 4);
+        juce::AudioBuffer<float> block (2, options.blockSize);
+        juce::MidiBuffer midi;
+
+        const int numBlocks = juce::jmax (1, (int) (options.seconds * options.sampleRate / options.blockSize));
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (auto& instance : instances)
+            {
+                block.makeCopyOf (input, true);
+
+                RealtimeSafety::ScopedRealtimeCheck realtimeCheck;
+                instance->processBlock (block, midi);
+            }
+        }
+
+        const auto elapsedSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+        const auto audioSeconds = numBlocks * options.blockSize / options.sampleRate;
+        const auto numLoaded = juce::jmax ((size_t) 1, instances.size());
+
+        std::cout << "  " << instances.size() << " loaded, "
+                  << juce::String (100.0 * elapsedSeconds / audioSeconds, 1) << "% of one core for all of them, "
+                  << juce::String (1.0e6 * elapsedSeconds / audioSeconds / (double) numLoaded, 1) << " us per second of audio each" << std::endl;
+
+        if (residentBefore > 0)
+        {
+            const auto afterRunning = getResidentBytes();
+            std::cout << "  " << juce::String ((double) (residentAfterLoading - residentBefore) / (double) numLoaded / 1024.0, 1)
+                      << " KB each once prepared, " << juce::String ((double) (afterRunning - residentBefore) / (double) numLoaded / 1024.0, 1)
+                      << " KB each after running" << std::endl;
+        }
+
+        if (instances.size() != (size_t) options.numInstances)
+            check (false, "every instance loaded");
+    }
+
+    //==============================================================================
+    juce::Result parseCommandLine (const juce::StringArray& args, Options& options)
+    {
+        auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+
+        for (int i = 0; i < args.size(); ++i)
+        {
+            auto arg = args[i];
+            auto nextValue = [&] { return i + 1 < args.size() ? args[++i].unquoted() : juce::String(); };
+
+            if (arg == "--instances")        options.numInstances = juce::jmax (1, nextValue().getIntValue());
+            else if (arg == "--seconds")     options.seconds = juce::jmax (0.05, nextValue().getDoubleValue());
+            else if (arg == "--rate")        options.sampleRate = juce::jlimit (8000.0, 384000.0, nextValue().getDoubleValue());
+            else if (arg == "--block-size")  options.blockSize = juce::jlimit (16, 8192, nextValue().getIntValue());
+            else if (arg == "--vst3")        options.vst3File = workingDirectory.getChildFile (nextValue());
+            else                             return juce::Result::fail ("Unknown option: " + arg);
+        }
+
+        return juce::Result::ok();
+    }
+
+    int checkRealtimeSafety (int exitCode)
+    {
+        const int numViolations = RealtimeSafety::getNumViolations();
+
+        if (numViolations == 0)
+            return exitCode;
+
+        std::cerr << numViolations << " realtime-safety violation(s) while processing" << std::endl;
+        return exitCode != 0 ? exitCode : 3;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add (argv[i]);
+
+    Options options;
+    auto parsed = parseCommandLine (args, options);
+
+    if (parsed.failed())
+    {
+        std::cerr << parsed.getErrorMessage() << std::endl
+                  << "Usage: DrawDelayPluginHost [--instances 200] [--seconds 2] [--rate 48000] [--block-size 512]\n"
+                     "                           [--vst3 <plugin file>]" << std::endl;
+        return 1;
+    }
+
+    // Plugins expect a message manager to exist, even though nothing here ever runs its loop
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    InstanceFactory factory (options);
+    auto initialised = factory.initialise();
+
+    if (initialised.failed())
+    {
+        std::cerr << initialised.getErrorMessage() << std::endl;
+        return 1;
+    }
+
+    runHostChecks (factory, options);
+    runManyInstances (factory, options);
+
+    if (numFailures > 0)
+        std::cerr << numFailures << " check(s) failed" << std::endl;
+
+    return checkRealtimeSafety (numFailures > 0 ? 1 : 0);
+}
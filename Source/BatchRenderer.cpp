@@ -0,0 +1,340 @@
+#include "BatchRenderer.h"
+#include <iostream>
+
+//==============================================================================
+class BatchRenderer::RenderJob  : public juce::ThreadPoolJob
+{
+public:
+    RenderJob (const Options& o, juce::AudioFormatManager& manager, const juce::File& in, AudioWorkerPool* pool)
+        : juce::ThreadPoolJob ("Render " + in.getFileName()),
+          options (o), formatManager (manager), input (in), output (getOutputFileFor (o, in)), workerPool (pool)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        auto startTime = juce::Time::getMillisecondCounterHiRes();
+        result = renderFile (options, formatManager, input, output, workerPool);
+        renderTimeMS = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+        return jobHasFinished;
+    }
+
+    const Options& options;
+    juce::AudioFormatManager& formatManager;
+    const juce::File input, output;
+    AudioWorkerPool* const workerPool;
+
+    juce::Result result { juce::Result::ok() };
+    double renderTimeMS = 0;
+};
+
+//==============================================================================
+bool BatchRenderer::isBatchCommandLine (const juce::StringArray& args)
+{
+    return args.contains ("--render");
+}
+
+juce::Result BatchRenderer::parseCommandLine (const juce::StringArray& args, const juce::String& audioFileWildcard, Options& options)
+{
+    auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+
+    for (int i = 0; i < args.size(); ++i)
+    {
+        auto arg = args[i];
+        auto nextValue = [&] { return i + 1 < args.size() ? args[++i].unquoted() : juce::String(); };
+
+        if (arg == "--render")
+            continue;
+
+        if (arg == "--taps")
+        {
+            auto result = parseTaps (nextValue(), options);
+
+            if (result.failed())
+                return result;
+        }
+        else if (arg == "--preset")
+        {
+            // The same files the app saves - the taps get added to any given with --taps
+            TapPattern pattern;
+            auto result = pattern.loadFromFile (workingDirectory.getChildFile (nextValue()));
+
+            if (result.failed())
+                return result;
+
+            options.delayTimesMS.addArray (pattern.delayTimesMS);
+            options.delayGains.addArray (pattern.delayGains);
+            options.feedback = pattern.feedback;
+        }
+        else if (arg == "--feedback")
+        {
+            options.feedback = juce::jlimit (0.0f, TapTable::maximumFeedback, nextValue().getFloatValue());
+        }
+        else if (arg == "--out")
+        {
+            options.outputFolder = workingDirectory.getChildFile (nextValue());
+        }
+        else if (arg == "--format")
+        {
+            options.format = nextValue().toLowerCase();
+
+            if (options.format != "wav" && options.format != "flac")
+                return juce::Result::fail ("Unsupported output format: " + options.format);
+        }
+        else if (arg == "--threads")
+        {
+            options.numThreads = juce::jmax (1, nextValue().getIntValue());
+        }
+        else if (arg == "--block-size")
+        {
+            options.blockSize = juce::jlimit (32, 65536, nextValue().getIntValue());
+        }
+        else if (arg == "--no-tail")
+        {
+            options.renderTail = false;
+        }
+        else if (arg == "--interpolation")
+        {
+            auto name = nextValue().toLowerCase();
+
+            if (name == "none")          options.interpolation = TapTable::Interpolation::none;
+            else if (name == "linear")   options.interpolation = TapTable::Interpolation::linear;
+            else if (name == "cubic")    options.interpolation = TapTable::Interpolation::cubic;
+            else                         return juce::Result::fail ("Unknown interpolation: " + name);
+        }
+        else if (arg == "--modulation")
+        {
+            // Rate and depth, the same way round as a tap's time and gain
+            auto value = nextValue();
+            options.modulationRateHz = juce::jmax (0.0f, value.upToFirstOccurrenceOf (":", false, false).trim().getFloatValue());
+            options.modulationDepthMS = juce::jlimit (0.0f, DelayEngine::maximumModulationDepthMS,
+                                                      value.fromFirstOccurrenceOf (":", false, false).trim().getFloatValue());
+        }
+        else if (arg == "--automation")
+        {
+            // Split at the first colon only - the preset's path might have one too
+            auto value = nextValue();
+            AutomationPoint point { value.upToFirstOccurrenceOf (":", false, false).trim().getDoubleValue(), {} };
+
+            if (! value.containsChar (':') || point.timeSeconds < 0.0)
+                return juce::Result::fail ("Automation needs a time in seconds and a preset, e.g. 2.5:echoes.ddtaps - got " + value);
+
+            auto result = point.pattern.loadFromFile (workingDirectory.getChildFile (value.fromFirstOccurrenceOf (":", false, false).trim()));
+
+            if (result.failed())
+                return result;
+
+            options.automation.push_back (point);
+        }
+        else if (arg.startsWith ("--"))
+        {
+            return juce::Result::fail ("Unknown option: " + arg);
+        }
+        else
+        {
+            // Anything else is an input - a folder means every audio file inside it
+            auto file = workingDirectory.getChildFile (arg.unquoted());
+
+            if (file.isDirectory())
+                options.inputFiles.addArray (file.findChildFiles (juce::File::findFiles, true, audioFileWildcard));
+            else if (file.existsAsFile())
+                options.inputFiles.add (file);
+            else
+                return juce::Result::fail ("Can't find input: " + file.getFullPathName());
+        }
+    }
+
+    if (options.inputFiles.isEmpty())
+        return juce::Result::fail ("No input files given");
+
+    if (options.delayTimesMS.isEmpty())
+        return juce::Result::fail ("No taps given - use --taps <ms>:<gain>,... or --preset <file>");
+
+    std::stable_sort (options.automation.begin(), options.automation.end(), [] (const AutomationPoint& a, const AutomationPoint& b)
+    {
+        return a.timeSeconds < b.timeSeconds;
+    });
+
+    return juce::Result::ok();
+}
+
+juce::Result BatchRenderer::parseTaps (const juce::String& text, Options& options)
+{
+    const int maximumDelayTimeMS = (int) (DelayEngine::maximumDelayTimeS * 1000);
+
+    for (auto& tap : juce::StringArray::fromTokens (text, ",", {}))
+    {
+        if (! tap.containsChar (':'))
+            return juce::Result::fail ("Taps need a time and a gain, e.g. 250:0.5 - got " + tap);
+
+        const float timeMS = tap.upToFirstOccurrenceOf (":", false, false).trim().getFloatValue();
+        const float gain = tap.fromFirstOccurrenceOf (":", false, false).trim().getFloatValue();
+
+        if (timeMS < 0 || timeMS > maximumDelayTimeMS)
+            return juce::Result::fail ("Tap times must be between 0 and " + juce::String (maximumDelayTimeMS) + "ms - got " + tap);
+
+        options.delayTimesMS.add (timeMS);
+        options.delayGains.add (gain);
+    }
+
+    return juce::Result::ok();
+}
+
+juce::File BatchRenderer::getOutputFileFor (const Options& options, const juce::File& input)
+{
+    auto folder = options.outputFolder == juce::File() ? input.getParentDirectory() : options.outputFolder;
+    return folder.getChildFile (input.getFileNameWithoutExtension() + "_delayed." + options.format);
+}
+
+//==============================================================================
+int BatchRenderer::run (const juce::StringArray& args)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    Options options;
+    auto parseResult = parseCommandLine (args, formatManager.getWildcardForAllFormats(), options);
+
+    if (parseResult.failed())
+    {
+        std::cerr << parseResult.getErrorMessage() << std::endl
+                  << "Usage: --render --taps <ms>:<gain>,... | --preset <file> [--out <folder>] [--format wav|flac] "
+                     "[--feedback <0-0.95>] [--interpolation none|linear|cubic] [--modulation <Hz>:<ms>] "
+                     "[--automation <seconds>:<preset file>]... [--threads <n>] [--block-size <n>] [--no-tail] <files or folders...>" << std::endl;
+        return 1;
+    }
+
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    // One job per file - the files don't share anything, so they can all go at once
+    juce::ThreadPool pool (juce::jmin (options.numThreads, options.inputFiles.size()));
+    juce::OwnedArray<RenderJob> jobs;
+
+    // With fewer files than threads the spare cores would sit idle, so let each file's channels use them too
+    std::unique_ptr<juce::SharedResourcePointer<AudioWorkerPool>> channelPool;
+
+    if (options.inputFiles.size() < options.numThreads)
+        channelPool = std::make_unique<juce::SharedResourcePointer<AudioWorkerPool>>();
+
+    for (auto& input : options.inputFiles)
+        pool.addJob (jobs.add (new RenderJob (options, formatManager, input, channelPool != nullptr ? channelPool->get() : nullptr)), false);
+
+    int numFailed = 0;
+
+    for (auto* job : jobs)
+    {
+        pool.waitForJobToFinish (job, -1);
+
+        if (job->result.wasOk())
+        {
+            std::cout << job->output.getFullPathName() << " (" << juce::String (job->renderTimeMS / 1000.0, 2) << "s)" << std::endl;
+        }
+        else
+        {
+            std::cerr << job->input.getFullPathName() << ": " << job->result.getErrorMessage() << std::endl;
+            ++numFailed;
+        }
+    }
+
+    std::cout << "Rendered " << (jobs.size() - numFailed) << " of " << jobs.size() << " files in "
+              << juce::String ((juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0, 2) << "s" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
+
+juce::Result BatchRenderer::renderFile (const Options& options, juce::AudioFormatManager& formatManager,
+                                        const juce::File& input, const juce::File& output,
+                                        AudioWorkerPool* workerPool)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (input));
+
+    if (reader == nullptr)
+        return juce::Result::fail ("Not an audio file this build can read");
+
+    const int numChannels = (int) reader->numChannels;
+    const double sampleRate = reader->sampleRate;
+    const juce::int64 inputLength = reader->lengthInSamples;
+
+    // Same engine the app plays through, just fed from the file instead of the device
+    DelayEngine engine;
+    engine.setWorkerPool (workerPool);
+    engine.setInterpolation (options.interpolation);
+    engine.prepare (sampleRate, options.blockSize, numChannels);
+    engine.setTaps (options.delayTimesMS, options.delayGains, options.feedback);
+    engine.setModulation (options.modulationRateHz, options.modulationDepthMS);
+
+    // Every automated preset is compiled before the render starts, so switching to one mid-block costs nothing
+    std::vector<std::pair<juce::int64, TapTable::Ptr>> automation;
+
+    for (auto& point : options.automation)
+        automation.push_back ({ (juce::int64) std::llround (point.timeSeconds * sampleRate),
+                                engine.createTapTable (point.pattern.delayTimesMS, point.pattern.delayGains, point.pattern.feedback) });
+
+    // Long enough for whichever taps are playing when the input ends
+    juce::int64 tailLength = 0;
+
+    if (options.renderTail)
+    {
+        auto getTailLength = [&] (const juce::Array<float>& delayTimesMS, float feedback)
+        {
+            return (juce::int64) std::ceil (DelayEngine::getTailLengthSeconds (delayTimesMS, feedback, options.modulationDepthMS) * sampleRate);
+        };
+
+        tailLength = getTailLength (options.delayTimesMS, options.feedback);
+
+        for (auto& point : options.automation)
+            tailLength = juce::jmax (tailLength, getTailLength (point.pattern.delayTimesMS, point.pattern.feedback));
+    }
+
+    std::unique_ptr<juce::AudioFormat> format;
+
+    if (options.format == "flac")
+        format = std::make_unique<juce::FlacAudioFormat>();
+    else
+        format = std::make_unique<juce::WavAudioFormat>();
+
+    output.getParentDirectory().createDirectory();
+    output.deleteFile();
+
+    std::unique_ptr<juce::OutputStream> stream (output.createOutputStream());
+
+    if (stream == nullptr)
+        return juce::Result::fail ("Couldn't create " + output.getFullPathName());
+
+    std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels,
+                                                                              24, {}, 0));
+
+    if (writer == nullptr)
+        return juce::Result::fail ("Can't write " + juce::String (numChannels) + " channels at "
+                                   + juce::String (sampleRate) + "Hz as " + options.format);
+
+    stream.release(); // The writer owns it now
+
+    juce::AudioBuffer<float> buffer (numChannels, options.blockSize);
+    const juce::int64 totalLength = inputLength + tailLength;
+    size_t nextAutomation = 0;
+
+    for (juce::int64 position = 0; position < totalLength; position += options.blockSize)
+    {
+        const int numSamples = (int) juce::jmin ((juce::int64) options.blockSize, totalLength - position);
+
+        // The engine counts samples from the start of the render too. Only this block's changes are handed over,
+        // so the queue can only fill up if one block has more than it holds - the rest then wait for the next.
+        while (nextAutomation < automation.size() && automation[nextAutomation].first < position + numSamples
+                && engine.scheduleTaps (automation[nextAutomation].second, automation[nextAutomation].first))
+            ++nextAutomation;
+
+        buffer.clear();
+
+        if (position < inputLength)
+            reader->read (&buffer, 0, (int) juce::jmin ((juce::int64) numSamples, inputLength - position), position, true, true);
+
+        engine.process (buffer, 0, numSamples);
+
+        if (! writer->writeFromAudioSampleBuffer (buffer, 0, numSamples))
+            return juce::Result::fail ("Write failed for " + output.getFullPathName());
+    }
+
+    return juce::Result::ok();
+}
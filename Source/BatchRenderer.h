@@ -0,0 +1,75 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Engine/DelayEngine.h"
+#include "TapPattern.h"
+
+//==============================================================================
+/*
+    Renders audio files through DelayEngine from the command line, with no window and
+    no audio device, as fast as the CPU allows.
+
+    Every input file is its own job on a juce::ThreadPool, so a folder full of stems
+    is spread over all the cores instead of being played through one at a time.
+
+    Usage:
+        "Draw Delay" --render --taps 250:0.5,500:0.3 | --preset <file> [--out <folder>] [--format wav|flac]
+                     [--feedback <0-0.95>] [--interpolation none|linear|cubic] [--modulation <Hz>:<ms>]
+                     [--automation <seconds>:<preset file>]... [--threads <n>] [--block-size <n>] [--no-tail]
+                     <files or folders...>
+
+    Taps are delay time in milliseconds (fractions allowed) and gain, separated by a colon. A preset saved
+    from the app (binary or XML) brings its taps and feedback amount with it.
+
+    Each --automation switches to another preset that many seconds into the file, on exactly that sample
+    (see DelayEngine::scheduleTaps()), so a render of the same file always changes in the same place.
+*/
+class BatchRenderer
+{
+public:
+    //==============================================================================
+    struct AutomationPoint
+    {
+        double timeSeconds;
+        TapPattern pattern;
+    };
+
+    struct Options
+    {
+        juce::Array<juce::File> inputFiles;
+        juce::File outputFolder;     // Left empty, each output goes next to its input
+        juce::String format { "wav" };
+
+        juce::Array<float> delayTimesMS;
+        juce::Array<float> delayGains;
+        float feedback = 0.0f;
+
+        TapTable::Interpolation interpolation = TapTable::Interpolation::linear;
+        float modulationRateHz = 0.0f, modulationDepthMS = 0.0f;
+
+        std::vector<AutomationPoint> automation; // In time order
+
+        int numThreads = juce::SystemStats::getNumCpus();
+        int blockSize = 4096;
+        bool renderTail = true;      // Keep going after the input ends until the taps (and any feedback) have died away
+    };
+
+    //==============================================================================
+    static bool isBatchCommandLine (const juce::StringArray& args);
+    static juce::Result parseCommandLine (const juce::StringArray& args, const juce::String& audioFileWildcard, Options& options);
+
+    /** Renders everything on the command line and returns the process exit code. */
+    static int run (const juce::StringArray& args);
+
+    /** Renders one file on the calling thread, splitting its channels over workerPool if one is given. */
+    static juce::Result renderFile (const Options& options, juce::AudioFormatManager& formatManager,
+                                    const juce::File& input, const juce::File& output,
+                                    AudioWorkerPool* workerPool = nullptr);
+
+    static juce::File getOutputFileFor (const Options& options, const juce::File& input);
+
+private:
+    class RenderJob;
+
+    static juce::Result parseTaps (const juce::String& text, Options& options);
+};
@@ -0,0 +1,307 @@
+#include "DelayBoxOverlay.h"
+
+//==============================================================================
+DelayBoxOverlay::DelayBoxOverlay (PeakCache& peakCacheToShow, LevelFifo& levelsToShow, juce::AudioTransportSource& transportToFollow,
+                                  const juce::Array<float>& tapTimesMS, const juce::Array<float>& tapGains, float maximumDelayTimeSeconds)
+    : peakCache (peakCacheToShow),
+      levels (levelsToShow),
+      transport (transportToFollow),
+      delayTimesMS (tapTimesMS),
+      delayGains (tapGains),
+      maximumDelayTimeS (maximumDelayTimeSeconds)
+{
+    setInterceptsMouseClicks (false, false); // Clicks go through to the taps underneath
+    peakCache.addChangeListener (this);
+    startTimerHz (framesPerSecond);
+}
+
+DelayBoxOverlay::~DelayBoxOverlay()
+{
+    peakCache.removeChangeListener (this);
+}
+
+void DelayBoxOverlay::setSampleRate (double newSampleRate)
+{
+    // The history is counted in samples, so what's in it now would be at the wrong times
+    sampleRate = newSampleRate;
+    levels.clearHistory();
+}
+
+void DelayBoxOverlay::setShowsLiveInput (bool shouldShowLiveInput)
+{
+    showsLiveInput = shouldShowLiveInput;
+    repaint();
+}
+
+//==============================================================================
+void DelayBoxOverlay::timerCallback()
+{
+    const int numNewSamples = levels.update();
+    const auto position = transport.getCurrentPosition();
+
+    // Only what's changed gets repainted - anything else would mean the whole box (and its tap layer) being redrawn underneath every frame
+    repaintHistoryIfScrolled (numNewSamples, position);
+    repaintOverviewIfMoved (position);
+    updateTapMeters();
+}
+
+void DelayBoxOverlay::changeListenerCallback (juce::ChangeBroadcaster*)
+{
+    // The peak cache has a new file, or has finished one
+    repaint();
+}
+
+void DelayBoxOverlay::repaintHistoryIfScrolled (int numNewSamples, double position)
+{
+    const auto area = getHistoryArea();
+
+    if (area.isEmpty())
+        return;
+
+    // A file's history follows the playhead, and live input's the samples coming in - either way, it's
+    // only worth redrawing once it's moved a whole pixel
+    if (showsFile())
+        samplesSinceHistoryDrawn = std::abs (position - historyPositionSeconds) * sampleRate;
+    else
+        samplesSinceHistoryDrawn += numNewSamples;
+
+    if (samplesSinceHistoryDrawn >= maximumDelayTimeS * sampleRate / area.getWidth())
+    {
+        historyPositionSeconds = position;
+        samplesSinceHistoryDrawn = 0.0;
+        repaint (area.getSmallestIntegerContainer());
+    }
+}
+
+void DelayBoxOverlay::repaintOverviewIfMoved (double position)
+{
+    if (position == lastPositionSeconds)
+        return;
+
+    if (showsFile())
+    {
+        // Just the strips the playhead and the start of the window have moved across
+        const auto area = getOverviewArea();
+
+        for (auto offset : { 0.0, (double) -maximumDelayTimeS })
+        {
+            const float from = getOverviewX (lastPositionSeconds + offset), to = getOverviewX (position + offset);
+            repaint (juce::Rectangle<float>::leftTopRightBottom (juce::jmin (from, to) - 2.0f, area.getY(), juce::jmax (from, to) + 2.0f, area.getBottom())
+                       .getSmallestIntegerContainer());
+        }
+    }
+
+    lastPositionSeconds = position;
+}
+
+void DelayBoxOverlay::updateTapMeters()
+{
+    const int numTaps = delayTimesMS.size();
+    meters.resize ((size_t) numTaps);
+
+    if (numTaps > 0)
+    {
+        // With more taps than that, each one's only looked at every few frames - over everything that's come in since last time
+        const int numToUpdate = juce::jmin (numTaps, maximumMeterUpdatesPerFrame);
+        const int framesPerUpdate = (numTaps + numToUpdate - 1) / numToUpdate;
+        const int window = juce::jmax (LevelFifo::samplesPerBin, juce::roundToInt (framesPerUpdate * sampleRate / framesPerSecond));
+        const float release = std::pow (meterReleasePerFrame, (float) framesPerUpdate);
+
+        for (int n = 0; n < numToUpdate; ++n)
+        {
+            const int i = nextMeterToUpdate = (nextMeterToUpdate + 1) % numTaps;
+            auto& meter = meters[(size_t) i];
+
+            const int samplesAgo = juce::roundToInt (delayTimesMS[i] * sampleRate / 1000.0);
+            meter.level = juce::jmax (levels.getInputPeak (samplesAgo, window) * delayGains[i], meter.level * release);
+
+            const int height = juce::roundToInt (meterHeight * toMeterProportion (meter.level));
+
+            if (height != meter.height)
+            {
+                meter.height = height;
+                repaint (getMeterArea (getTapCentre (i)).getSmallestIntegerContainer());
+            }
+
+            if (height > 0 && ! meter.isLit)
+            {
+                meter.isLit = true;
+                litMeters.push_back (i);
+            }
+        }
+    }
+
+    // Meters that have fallen back to nothing (or whose taps have gone) drop out of the ones paint() goes through
+    litMeters.erase (std::remove_if (litMeters.begin(), litMeters.end(), [this, numTaps] (int i)
+                                     {
+                                         if (i >= numTaps)
+                                             return true;
+
+                                         auto& meter = meters[(size_t) i];
+                                         meter.isLit = meter.height > 0;
+                                         return ! meter.isLit;
+                                     }),
+                     litMeters.end());
+}
+
+//==============================================================================
+void DelayBoxOverlay::paint (juce::Graphics& g)
+{
+    if (showsFile())
+        paintOverview (g, getOverviewArea());
+
+    paintHistory (g, getHistoryArea());
+    paintTapMeters (g);
+}
+
+void DelayBoxOverlay::paintHistory (juce::Graphics& g, juce::Rectangle<float> area)
+{
+    const int width = (int) area.getWidth();
+
+    if (width <= 0)
+        return;
+
+    peaks.resize ((size_t) width);
+
+    if (showsFile())
+    {
+        // The cache goes forwards in time, and the box goes backwards from now
+        peakCache.getPeaks (historyPositionSeconds - maximumDelayTimeS, historyPositionSeconds, peaks.data(), width);
+        std::reverse (peaks.begin(), peaks.end());
+    }
+    else
+    {
+        // Only the size of live input is known, so it's drawn the same above and below the middle
+        const double samplesPerPixel = maximumDelayTimeS * sampleRate / width;
+
+        for (int x = 0; x < width; ++x)
+        {
+            const float level = levels.getInputPeak ((int) (x * samplesPerPixel), (int) std::ceil (samplesPerPixel));
+            peaks[(size_t) x] = { -level, level };
+        }
+    }
+
+    const float centre = area.getCentreY();
+    const float halfHeight = area.getHeight() / 2.0f;
+
+    g.setColour (juce::Colours::steelblue.withAlpha (0.35f));
+
+    for (int x = 0; x < width; ++x)
+    {
+        const auto& peak = peaks[(size_t) x];
+
+        if (! peak.isEmpty())
+            g.fillRect (area.getX() + (float) x, centre - peak.getEnd() * halfHeight, 1.0f, peak.getLength() * halfHeight);
+    }
+}
+
+void DelayBoxOverlay::paintOverview (juce::Graphics& g, juce::Rectangle<float> area)
+{
+    const int width = (int) area.getWidth();
+    const auto length = peakCache.getLengthInSeconds();
+
+    if (width <= 0 || length <= 0.0)
+        return;
+
+    g.setColour (juce::Colours::black.withAlpha (0.08f));
+    g.fillRect (area);
+
+    peaks.resize ((size_t) width);
+    peakCache.getPeaks (0.0, length, peaks.data(), width);
+
+    const float centre = area.getCentreY();
+    const float halfHeight = area.getHeight() / 2.0f;
+
+    g.setColour (juce::Colours::darkgrey.withAlpha (0.6f));
+
+    for (int x = 0; x < width; ++x)
+    {
+        const auto& peak = peaks[(size_t) x];
+
+        if (! peak.isEmpty())
+            g.fillRect (area.getX() + (float) x, centre - peak.getEnd() * halfHeight, 1.0f, peak.getLength() * halfHeight);
+    }
+
+    // The stretch of the file the box above is showing, ending at the playhead
+    const float playheadX = getOverviewX (lastPositionSeconds);
+    const float windowX = getOverviewX (lastPositionSeconds - maximumDelayTimeS);
+
+    g.setColour (juce::Colours::steelblue.withAlpha (0.2f));
+    g.fillRect (juce::Rectangle<float> (windowX, area.getY(), playheadX - windowX, area.getHeight()));
+
+    g.setColour (juce::Colours::red);
+    g.fillRect (playheadX - 1.0f, area.getY(), 2.0f, area.getHeight());
+}
+
+void DelayBoxOverlay::paintTapMeters (juce::Graphics& g)
+{
+    // Only meters showing something, and only the ones in the area being repainted
+    const auto clip = g.getClipBounds().toFloat();
+
+    for (auto i : litMeters)
+    {
+        if (i >= delayTimesMS.size())
+            continue;
+
+        const auto meterArea = getMeterArea (getTapCentre (i));
+
+        if (! meterArea.intersects (clip))
+            continue;
+
+        const auto& meter = meters[(size_t) i];
+        const float proportion = toMeterProportion (meter.level);
+
+        g.setColour (proportion < 0.8f ? juce::Colours::green : (proportion < 0.95f ? juce::Colours::orange : juce::Colours::red));
+        g.fillRect (meterArea.withTop (meterArea.getBottom() - (float) meter.height));
+    }
+}
+
+//==============================================================================
+juce::Rectangle<float> DelayBoxOverlay::getMeterArea (juce::Point<float> tapCentre) noexcept
+{
+    return { tapCentre.x + meterOffset, tapCentre.y - meterHeight / 2.0f, meterWidth, meterHeight };
+}
+
+bool DelayBoxOverlay::showsFile() const noexcept
+{
+    return peakCache.hasFile() && ! showsLiveInput;
+}
+
+juce::Rectangle<float> DelayBoxOverlay::getHistoryArea() const noexcept
+{
+    auto area = getLocalBounds().toFloat();
+
+    if (showsFile())
+        area.removeFromBottom (overviewHeight);
+
+    return area;
+}
+
+juce::Rectangle<float> DelayBoxOverlay::getOverviewArea() const noexcept
+{
+    return getLocalBounds().toFloat().removeFromBottom (overviewHeight);
+}
+
+float DelayBoxOverlay::getOverviewX (double seconds) const noexcept
+{
+    const auto area = getOverviewArea();
+    const auto length = peakCache.getLengthInSeconds();
+
+    return area.getX() + area.getWidth() * (length > 0.0 ? (float) juce::jlimit (0.0, 1.0, seconds / length) : 0.0f);
+}
+
+juce::Point<float> DelayBoxOverlay::getTapCentre (int index) const noexcept
+{
+    // Taps are placed over the whole box, the same as MainComponent does
+    const auto area = getLocalBounds().toFloat();
+
+    return { area.getX() + area.getWidth() * delayTimesMS[index] / (maximumDelayTimeS * 1000.0f),
+             area.getY() + area.getHeight() * (1.0f - delayGains[index]) };
+}
+
+float DelayBoxOverlay::toMeterProportion (float gain) noexcept
+{
+    // 60dB of range, so quiet echoes still show
+    constexpr float floorDB = -60.0f;
+    return juce::jlimit (0.0f, 1.0f, (juce::Decibels::gainToDecibels (gain, floorDB) - floorDB) / -floorDB);
+}
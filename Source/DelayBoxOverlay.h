@@ -0,0 +1,106 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Engine/LevelFifo.h"
+#include "PeakCache.h"
+
+//==============================================================================
+/*
+    Sits on top of the delay box and shows what the taps are doing, updated at
+    60fps without going near the audio thread. Only the parts that have changed
+    are repainted, since anything under the overlay gets redrawn along with it.
+
+    Across the box is the audio the taps are reading: the same time scale as the
+    taps, with now at the left edge and maximumDelayTimeS ago at the right, so
+    a sound scrolls across the box and passes under each tap as that tap repeats
+    it. A file is drawn from its PeakCache, around the transport's position; live
+    input (which has no file to look at) from the levels the audio thread sends.
+
+    Along the bottom is the whole file, with a playhead running across it.
+
+    Each tap has a small meter beside it: the input level as far back as the tap's
+    delay, times its gain - how loud that tap is right now.
+
+    It doesn't take mouse clicks, and its background is clear, so the taps drawn
+    underneath it stay visible and editable.
+*/
+class DelayBoxOverlay  : public juce::Component,
+                         private juce::Timer,
+                         private juce::ChangeListener
+{
+public:
+    /** The tap arrays are MainComponent's own, read on each redraw. */
+    DelayBoxOverlay (PeakCache& peakCacheToShow, LevelFifo& levelsToShow, juce::AudioTransportSource& transportToFollow,
+                     const juce::Array<float>& tapTimesMS, const juce::Array<float>& tapGains, float maximumDelayTimeSeconds);
+    ~DelayBoxOverlay() override;
+
+    void setSampleRate (double newSampleRate);
+
+    /** Live input shows what's coming into the device, rather than the file. */
+    void setShowsLiveInput (bool shouldShowLiveInput);
+
+    void paint (juce::Graphics& g) override;
+
+    /** Where the meter beside a tap centred at tapCentre goes, at its tallest. Whatever redraws a tap
+        should repaint this too, as a meter is only repainted here when its level changes.
+    */
+    static juce::Rectangle<float> getMeterArea (juce::Point<float> tapCentre) noexcept;
+
+private:
+    //==============================================================================
+    void timerCallback() override;
+    void changeListenerCallback (juce::ChangeBroadcaster*) override;
+
+    void repaintHistoryIfScrolled (int numNewSamples, double position);
+    void repaintOverviewIfMoved (double position);
+    void updateTapMeters();
+
+    void paintHistory (juce::Graphics& g, juce::Rectangle<float> area);
+    void paintOverview (juce::Graphics& g, juce::Rectangle<float> area);
+    void paintTapMeters (juce::Graphics& g);
+
+    bool showsFile() const noexcept;
+    juce::Rectangle<float> getHistoryArea() const noexcept;
+    juce::Rectangle<float> getOverviewArea() const noexcept;
+    float getOverviewX (double seconds) const noexcept;
+    juce::Point<float> getTapCentre (int index) const noexcept;
+
+    static float toMeterProportion (float gain) noexcept;
+
+    //==============================================================================
+    PeakCache& peakCache;
+    LevelFifo& levels;
+    juce::AudioTransportSource& transport;
+    const juce::Array<float>& delayTimesMS;
+    const juce::Array<float>& delayGains;
+    const float maximumDelayTimeS;
+
+    double sampleRate = 44100.0;
+    bool showsLiveInput = false;
+    double lastPositionSeconds = -1.0;      // Where the overview's playhead is
+    double historyPositionSeconds = -1.0;   // Where the history was last scrolled to
+    double samplesSinceHistoryDrawn = 0.0;
+
+    std::vector<juce::Range<float>> peaks;  // Reused for every redraw
+
+    // What each tap's meter shows, falling back slowly. Only a few hundred are looked at each frame, and
+    // paint() only goes through the ones that are showing anything, so thousands of taps don't cost thousands of meters a frame.
+    struct TapMeter
+    {
+        float level = 0.0f;
+        int height = 0;         // In whole pixels - the meter's only repainted when this changes
+        bool isLit = false;     // In litMeters
+    };
+
+    std::vector<TapMeter> meters;
+    std::vector<int> litMeters;
+    int nextMeterToUpdate = 0;
+
+    static constexpr int framesPerSecond = 60;
+    static constexpr float overviewHeight = 16.0f;
+    static constexpr float meterReleasePerFrame = 0.85f;
+    static constexpr int maximumMeterUpdatesPerFrame = 256;
+    static constexpr float meterOffset = 7.0f, meterWidth = 3.0f, meterHeight = 12.0f; // Beside each tap's circle, rising from its bottom edge
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayBoxOverlay)
+};
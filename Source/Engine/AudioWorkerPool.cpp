@@ -0,0 +1,185 @@
+#include "AudioWorkerPool.h"
+#include "RealtimeSafety.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace
+{
+    // Tells the CPU we're busy-waiting, so the core it shares with another thread isn't starved
+    inline void pauseWhileSpinning() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (defined (__aarch64__) || defined (_M_ARM64))
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+}
+
+//==============================================================================
+class AudioWorkerPool::Worker  : public juce::Thread
+{
+public:
+    Worker (AudioWorkerPool& p, int index)
+        : juce::Thread ("Audio worker " + juce::String (index)), pool (p)
+    {
+    }
+
+    void run() override
+    {
+        // Keep spinning for a little while after the last task - the next one is usually close behind
+        const auto spinTicks = juce::Time::secondsToHighResolutionTicks (0.0002);
+        auto idleSince = juce::Time::getHighResolutionTicks();
+
+        while (! threadShouldExit())
+        {
+            bool didWork = false;
+
+            for (auto& slot : pool.slots)
+                didWork = pool.helpWith (slot) || didWork;
+
+            if (didWork)
+            {
+                idleSince = juce::Time::getHighResolutionTicks();
+                continue;
+            }
+
+            if (juce::Time::getHighResolutionTicks() - idleSince < spinTicks)
+            {
+                pauseWhileSpinning();
+                continue;
+            }
+
+            // Count ourselves as asleep before the last look, so a job published in between still wakes us
+            ++pool.numSleepingWorkers;
+
+            if (! pool.hasWork())
+                wakeUp.wait (100);
+
+            --pool.numSleepingWorkers;
+            idleSince = juce::Time::getHighResolutionTicks();
+        }
+    }
+
+    juce::WaitableEvent wakeUp;
+
+private:
+    AudioWorkerPool& pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Worker)
+};
+
+//==============================================================================
+AudioWorkerPool::AudioWorkerPool()
+{
+    const int numWorkers = juce::jmax (0, juce::SystemStats::getNumCpus() - 1);
+
+    for (int i = 0; i < numWorkers; ++i)
+        workers.add (new Worker (*this, i))->startThread (juce::Thread::realtimeAudioPriority);
+}
+
+AudioWorkerPool::~AudioWorkerPool()
+{
+    for (auto* worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->wakeUp.signal();
+    }
+
+    for (auto* worker : workers)
+        worker->stopThread (1000);
+
+    // Nobody should still be waiting on a job now
+    for (auto& slot : slots)
+        jassert (slot.job.load() == nullptr);
+}
+
+//==============================================================================
+bool AudioWorkerPool::run (Job& job) noexcept
+{
+    Slot* slot = nullptr;
+
+    if (job.numTasks > 1 && ! workers.isEmpty())
+    {
+        for (auto& s : slots)
+        {
+            Job* expected = nullptr;
+
+            if (s.job.compare_exchange_strong (expected, &job))
+            {
+                slot = &s;
+                break;
+            }
+        }
+    }
+
+    if (slot != nullptr && numSleepingWorkers.load() > 0)
+    {
+        // Signalling takes the event's lock, which a worker only holds while it goes to sleep
+        RealtimeSafety::ScopedAllowance wakingWorkers (RealtimeSafety::lock);
+
+        for (int i = 0; i < juce::jmin (job.numTasks - 1, workers.size()); ++i)
+            workers.getUnchecked (i)->wakeUp.signal();
+    }
+
+    // The caller works on its own job rather than waiting for somebody else to
+    runTasks (job);
+
+    if (slot != nullptr)
+    {
+        // Stop anyone new picking it up, then wait for the tasks already taken and for the helpers to let go
+        slot->job.store (nullptr);
+
+        while (job.numFinished.load (std::memory_order_acquire) < job.numTasks)
+            pauseWhileSpinning();
+
+        while (slot->numHelpers.load() != 0)
+            pauseWhileSpinning();
+    }
+
+    return juce::Time::getHighResolutionTicks() <= job.deadlineTicks;
+}
+
+bool AudioWorkerPool::helpWith (Slot& slot) noexcept
+{
+    bool didWork = false;
+    ++slot.numHelpers;
+
+    if (auto* job = slot.job.load())
+        if (juce::Time::getHighResolutionTicks() < job->deadlineTicks)
+            didWork = runTasks (*job) > 0;
+
+    --slot.numHelpers;
+    return didWork;
+}
+
+bool AudioWorkerPool::hasWork() const noexcept
+{
+    for (auto& slot : slots)
+        if (slot.job.load() != nullptr)
+            return true;
+
+    return false;
+}
+
+int AudioWorkerPool::runTasks (Job& job) noexcept
+{
+    // The caller's own thread is already being checked - a worker has to start checking for itself
+    const RealtimeSafety::ScopedRealtimeCheck realtimeCheck (job.isRealtimeChecked && ! RealtimeSafety::isCheckingThisThread());
+
+    int numRun = 0;
+
+    for (;;)
+    {
+        const int task = job.nextTask.fetch_add (1);
+
+        if (task >= job.numTasks)
+            return numRun;
+
+        job.function (job.context, task);
+        job.numFinished.fetch_add (1, std::memory_order_release);
+        ++numRun;
+    }
+}
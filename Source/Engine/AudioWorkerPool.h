@@ -0,0 +1,95 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "RealtimeSafety.h"
+#include <array>
+#include <atomic>
+
+//==============================================================================
+/*
+    A pool of worker threads that audio callbacks can share.
+
+    parallelFor() splits a callback's work into tasks (one per channel, or one per
+    engine instance) and publishes them as a job. The calling thread starts on its
+    own job straight away. Idle workers steal tasks from any published job, so
+    several engines calling in from different threads all share the same cores.
+
+    Nothing on the calling side locks or allocates. Because the caller works through
+    its own tasks, the join only ever waits for tasks a worker has already started,
+    and it spins rather than sleeps so it can't be descheduled past the deadline.
+    Workers won't start a task once its deadline has gone - the caller will get to it
+    sooner than a late worker would. If the caller is inside a realtime-safety check,
+    the tasks a worker runs for it are checked too.
+
+    Share one pool between everything in the process with a
+    juce::SharedResourcePointer<AudioWorkerPool>.
+*/
+class AudioWorkerPool
+{
+public:
+    //==============================================================================
+    /** Starts one worker for every core but the caller's. */
+    AudioWorkerPool();
+    ~AudioWorkerPool();
+
+    int getNumWorkers() const noexcept    { return workers.size(); }
+
+    /** Calls function (i) for i in [0, numTasks), spread over the pool and the calling thread,
+        and returns once every call has finished.
+
+        deadlineTicks is a juce::Time::getHighResolutionTicks() time. Returns false if the
+        tasks finished after it.
+    */
+    template <typename Function>
+    bool parallelFor (int numTasks, juce::int64 deadlineTicks, Function&& function) noexcept
+    {
+        using FunctionType = std::remove_reference_t<Function>;
+
+        Job job (numTasks, deadlineTicks, RealtimeSafety::isCheckingThisThread(), &function,
+                 [] (void* context, int index) { (*static_cast<FunctionType*> (context)) (index); });
+
+        return run (job);
+    }
+
+private:
+    //==============================================================================
+    struct Job
+    {
+        using TaskFunction = void (*) (void* context, int index);
+
+        Job (int tasks, juce::int64 deadline, bool checked, void* taskContext, TaskFunction taskFunction) noexcept
+            : numTasks (tasks), deadlineTicks (deadline), isRealtimeChecked (checked), context (taskContext), function (taskFunction) {}
+
+        const int numTasks;
+        const juce::int64 deadlineTicks;
+        const bool isRealtimeChecked; // The caller is inside a RealtimeSafety check, so its tasks are too, wherever they run
+        void* const context;
+        const TaskFunction function;
+
+        std::atomic<int> nextTask { 0 };
+        std::atomic<int> numFinished { 0 };
+    };
+
+    // A job is published in a free slot. Helpers register in the slot before they look at its job,
+    // so the caller knows when nobody can still be touching it (it lives on the caller's stack).
+    struct Slot
+    {
+        std::atomic<Job*> job { nullptr };
+        std::atomic<int> numHelpers { 0 };
+    };
+
+    class Worker;
+
+    bool run (Job&) noexcept;
+    bool helpWith (Slot&) noexcept;
+    bool hasWork() const noexcept;
+    static int runTasks (Job&) noexcept;
+
+    static constexpr int maximumJobs = 32; // Past this many callers at once, the rest just run on their own thread
+
+    std::array<Slot, maximumJobs> slots;
+    juce::OwnedArray<Worker> workers;
+    std::atomic<int> numSleepingWorkers { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioWorkerPool)
+};
@@ -0,0 +1,197 @@
+#include "CallbackProfiler.h"
+
+//==============================================================================
+const char* CallbackProfiler::getSectionName (int section) noexcept
+{
+    switch (section)
+    {
+        case transportRead:       return "transportRead";
+        case fillDelayBuffer:     return "fillDelayBuffer";
+        case getFromDelayBuffer:  return "getFromDelayBuffer";
+        case applyGain:           return "applyGain";
+        default:                  return "";
+    }
+}
+
+CallbackProfiler::CallbackProfiler() = default;
+
+CallbackProfiler::~CallbackProfiler()
+{
+    stopCSV();
+}
+
+//==============================================================================
+void CallbackProfiler::prepare (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+}
+
+void CallbackProfiler::beginCallback() noexcept
+{
+    current.sectionTicks.fill (0);
+    current.startTicks = juce::Time::getHighResolutionTicks();
+}
+
+void CallbackProfiler::endCallback (int numSamples, int numXrunsSoFar) noexcept
+{
+    current.totalTicks = juce::Time::getHighResolutionTicks() - current.startTicks;
+    current.numSamples = numSamples;
+    current.numXruns = numXrunsSoFar;
+
+    // If the message thread has stopped reading, drop the record rather than wait
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+    {
+        records[(size_t) start1] = current;
+        fifo.finishedWrite (1);
+    }
+    else
+    {
+        numDropped.fetch_add (1, std::memory_order_relaxed);
+    }
+}
+
+//==============================================================================
+void CallbackProfiler::update()
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+
+    statistics.recentLoad = 0.0;
+
+    auto takeRecords = [this] (int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            auto& record = records[(size_t) i];
+
+            for (int s = 0; s < numSections; ++s)
+                statistics.sections[(size_t) s].add (getPercentOfPeriod (record.sectionTicks[(size_t) s], record.numSamples));
+
+            const auto load = getPercentOfPeriod (record.totalTicks, record.numSamples);
+            statistics.load.add (load);
+            statistics.recentLoad = juce::jmax (statistics.recentLoad, load);
+
+            ++statistics.numCallbacks;
+
+            if (load > 100.0)
+                ++statistics.numOverruns;
+
+            statistics.numXruns = record.numXruns;
+
+            if (csvStream != nullptr)
+                writeCSVLine (record);
+        }
+    };
+
+    takeRecords (start1, size1);
+    takeRecords (start2, size2);
+    fifo.finishedRead (size1 + size2);
+
+    statistics.numDropped = numDropped.load (std::memory_order_relaxed);
+
+    if (csvStream != nullptr)
+        csvStream->flush();
+}
+
+void CallbackProfiler::resetStatistics()
+{
+    auto numXruns = statistics.numXruns; // A device total, so it carries on from where it was
+
+    statistics = {};
+    statistics.numXruns = numXruns;
+    numDropped = 0;
+}
+
+double CallbackProfiler::getPercentOfPeriod (juce::int64 ticks, int numSamples) const noexcept
+{
+    if (numSamples <= 0)
+        return 0.0;
+
+    const double period = numSamples / sampleRate.load();
+    return 100.0 * juce::Time::highResolutionTicksToSeconds (ticks) / period;
+}
+
+//==============================================================================
+juce::Result CallbackProfiler::startCSV (const juce::File& file)
+{
+    stopCSV();
+
+    file.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream> (file);
+
+    if (stream->failedToOpen())
+        return juce::Result::fail ("Couldn't write to " + file.getFullPathName());
+
+    *stream << "startSeconds,numSamples";
+
+    for (int s = 0; s < numSections; ++s)
+        *stream << "," << getSectionName (s) << "Micros";
+
+    *stream << ",totalMicros,loadPercent,xruns\n";
+
+    csvStream = std::move (stream);
+    return juce::Result::ok();
+}
+
+void CallbackProfiler::stopCSV()
+{
+    if (csvStream != nullptr)
+        csvStream->flush();
+
+    csvStream.reset();
+}
+
+void CallbackProfiler::writeCSVLine (const Record& record)
+{
+    auto toMicroseconds = [] (juce::int64 ticks) { return juce::String (juce::Time::highResolutionTicksToSeconds (ticks) * 1.0e6, 2); };
+
+    juce::String line;
+    line << juce::String (juce::Time::highResolutionTicksToSeconds (record.startTicks), 6) << "," << record.numSamples;
+
+    for (auto ticks : record.sectionTicks)
+        line << "," << toMicroseconds (ticks);
+
+    line << "," << toMicroseconds (record.totalTicks)
+         << "," << juce::String (getPercentOfPeriod (record.totalTicks, record.numSamples), 2)
+         << "," << record.numXruns << "\n";
+
+    *csvStream << line;
+}
+
+//==============================================================================
+void CallbackProfiler::Histogram::add (double percent) noexcept
+{
+    const int bin = juce::jlimit (0, numBins - 1, (int) (percent / binWidth));
+    ++bins[(size_t) bin];
+    ++count;
+    sum += percent;
+    maximum = juce::jmax (maximum, percent);
+}
+
+void CallbackProfiler::Histogram::reset() noexcept
+{
+    *this = {};
+}
+
+double CallbackProfiler::Histogram::getPercentile (double fraction) const noexcept
+{
+    if (count == 0)
+        return 0.0;
+
+    const auto target = (juce::int64) std::ceil (fraction * (double) count);
+    juce::int64 seen = 0;
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        seen += bins[(size_t) bin];
+
+        // The top of the bin, so a percentile never reads lower than what was measured
+        if (seen >= target)
+            return juce::jmin (maximum, (bin + 1) * binWidth);
+    }
+
+    return maximum;
+}
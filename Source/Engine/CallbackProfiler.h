@@ -0,0 +1,140 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+
+//==============================================================================
+/*
+    Timing for the audio callback.
+
+    The audio thread fills in one Record per callback - how long each part of it
+    took, and how much of the block's period the whole callback used - and pushes it
+    onto a lock-free SPSC fifo. Nothing on that side locks, allocates or does I/O.
+
+    The message thread calls update() to drain the fifo into histograms (so it can
+    report percentiles rather than just averages), and can stream every record to a
+    CSV file for looking at offline.
+*/
+class CallbackProfiler
+{
+public:
+    //==============================================================================
+    enum Section
+    {
+        transportRead,
+        fillDelayBuffer,
+        getFromDelayBuffer,
+        applyGain,
+        numSections
+    };
+
+    static const char* getSectionName (int section) noexcept;
+
+    struct Record
+    {
+        juce::int64 startTicks;                  // juce::Time::getHighResolutionTicks() when the callback began
+        std::array<juce::int64, numSections> sectionTicks;
+        juce::int64 totalTicks;
+        int numSamples;
+        int numXruns;                            // The device's running count, as of this callback
+    };
+
+    CallbackProfiler();
+    ~CallbackProfiler();
+
+    //==============================================================================
+    /** Audio thread: call when the device (re)starts. */
+    void prepare (double sampleRate);
+
+    /** Audio thread: starts a record for this callback. */
+    void beginCallback() noexcept;
+
+    /** Audio thread: adds time to a section of the current callback. */
+    void addSectionTime (Section section, juce::int64 ticks) noexcept    { current.sectionTicks[(size_t) section] += ticks; }
+
+    /** Audio thread: times its own lifetime as part of a section. */
+    struct ScopedSection
+    {
+        ScopedSection (CallbackProfiler& p, Section s) noexcept
+            : profiler (p), section (s), startTicks (juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedSection() noexcept    { profiler.addSectionTime (section, juce::Time::getHighResolutionTicks() - startTicks); }
+
+        CallbackProfiler& profiler;
+        const Section section;
+        const juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedSection)
+    };
+
+    /** Audio thread: finishes the record and hands it to the message thread. */
+    void endCallback (int numSamples, int numXrunsSoFar) noexcept;
+
+    //==============================================================================
+    /** Fixed-width bins of callback load, in percent of the block's period. */
+    class Histogram
+    {
+    public:
+        void add (double percent) noexcept;
+        void reset() noexcept;
+
+        double getPercentile (double fraction) const noexcept;
+        double getMean() const noexcept       { return count > 0 ? sum / (double) count : 0.0; }
+        double getMaximum() const noexcept    { return maximum; }
+        juce::int64 getCount() const noexcept { return count; }
+
+        static constexpr double binWidth = 0.5;   // Percent
+        static constexpr int numBins = 512;       // The last bin holds anything over 255%
+
+    private:
+        std::array<juce::int64, numBins> bins{};
+        juce::int64 count = 0;
+        double sum = 0.0, maximum = 0.0;
+    };
+
+    struct Statistics
+    {
+        std::array<Histogram, numSections> sections;
+        Histogram load;                 // The whole callback
+        double recentLoad = 0.0;        // Highest load since the last update()
+        juce::int64 numCallbacks = 0;
+        juce::int64 numOverruns = 0;    // Callbacks that took longer than their block's period
+        juce::int64 numDropped = 0;     // Records lost because the message thread fell behind
+        int numXruns = 0;
+    };
+
+    /** Message thread: takes in everything the audio thread has recorded since the last call. */
+    void update();
+
+    /** Message thread: the totals since the last resetStatistics(). */
+    const Statistics& getStatistics() const noexcept    { return statistics; }
+    void resetStatistics();
+
+    /** Message thread: from the next update(), appends a line per callback to this file. */
+    juce::Result startCSV (const juce::File& file);
+    void stopCSV();
+    bool isWritingCSV() const noexcept    { return csvStream != nullptr; }
+
+private:
+    //==============================================================================
+    void writeCSVLine (const Record&);
+
+    double getPercentOfPeriod (juce::int64 ticks, int numSamples) const noexcept;
+
+    // Audio thread only
+    Record current{};
+
+    std::atomic<double> sampleRate{ 44100.0 };
+    std::atomic<juce::int64> numDropped{ 0 };
+
+    static constexpr int fifoSize = 1024; // About 6 seconds of 256-sample callbacks at 44.1k
+    juce::AbstractFifo fifo{ fifoSize };
+    std::array<Record, fifoSize> records;
+
+    // Message thread only
+    Statistics statistics;
+    std::unique_ptr<juce::FileOutputStream> csvStream;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CallbackProfiler)
+};
@@ -0,0 +1,63 @@
+#include "CompactSamples.h"
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <immintrin.h>
+ #define DRAWDELAY_COMPACT_SSE 1
+#elif (defined (__ARM_NEON) || defined (__ARM_NEON__)) && defined (__aarch64__)
+ #include <arm_neon.h>
+ #define DRAWDELAY_COMPACT_NEON 1
+#endif
+
+namespace CompactSamples
+{
+//==============================================================================
+void convert (juce::int16* dest, const float* source, int num) noexcept
+{
+    int i = 0;
+
+   #if DRAWDELAY_COMPACT_SSE
+    // Clamp first - an out of range float converts to 0x80000000, which would saturate the wrong way
+    const auto scale = _mm_set1_ps (floatToInt16);
+    const auto lowest = _mm_set1_ps (-32768.0f), highest = _mm_set1_ps (32767.0f);
+
+    for (; i + 8 <= num; i += 8)
+    {
+        auto a = _mm_min_ps (highest, _mm_max_ps (lowest, _mm_mul_ps (_mm_loadu_ps (source + i), scale)));
+        auto b = _mm_min_ps (highest, _mm_max_ps (lowest, _mm_mul_ps (_mm_loadu_ps (source + i + 4), scale)));
+
+        _mm_storeu_si128 (reinterpret_cast<__m128i*> (dest + i), _mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b)));
+    }
+   #elif DRAWDELAY_COMPACT_NEON
+    const auto scale = vdupq_n_f32 (floatToInt16);
+
+    for (; i + 8 <= num; i += 8)
+    {
+        // Rounds to nearest, then narrows with saturation
+        auto a = vqmovn_s32 (vcvtnq_s32_f32 (vmulq_f32 (vld1q_f32 (source + i), scale)));
+        auto b = vqmovn_s32 (vcvtnq_s32_f32 (vmulq_f32 (vld1q_f32 (source + i + 4), scale)));
+
+        vst1q_s16 (dest + i, vcombine_s16 (a, b));
+    }
+   #endif
+
+    for (; i < num; ++i)
+        dest[i] = toInt16 (source[i]);
+}
+
+void convert (Half* dest, const float* source, int num) noexcept
+{
+    int i = 0;
+
+   #if DRAWDELAY_COMPACT_SSE && defined (__F16C__)
+    for (; i + 8 <= num; i += 8)
+        _mm_storeu_si128 (reinterpret_cast<__m128i*> (dest + i),
+                          _mm256_cvtps_ph (_mm256_loadu_ps (source + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+   #elif DRAWDELAY_COMPACT_NEON
+    for (; i + 4 <= num; i += 4)
+        vst1_u16 (reinterpret_cast<uint16_t*> (dest + i), vreinterpret_u16_f16 (vcvt_f16_f32 (vld1q_f32 (source + i))));
+   #endif
+
+    for (; i < num; ++i)
+        dest[i] = toHalf (source[i]);
+}
+}
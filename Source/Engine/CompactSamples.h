@@ -0,0 +1,118 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <cstring>
+
+//==============================================================================
+/*
+    The 16-bit sample formats a DelayLine can be stored in, to halve its memory
+    footprint (and the bandwidth every tap read costs) at some cost in noise.
+
+    int16 is fixed point with int16FullScale of headroom, so it has a constant noise
+    floor - about 92dB below full scale - and hard-clips anything louder. float16
+    (IEEE half precision) keeps about 66dB of signal-to-noise at any level and
+    doesn't clip below 65504, so it's the safer choice with lots of feedback.
+
+    The bulk conversions here are vectorised where the instruction set has them;
+    the tap kernel does its own conversion on read (see MultiTapKernel).
+*/
+namespace CompactSamples
+{
+    /** An IEEE 754 half-precision float, just as bits. */
+    struct Half
+    {
+        juce::uint16 bits;
+    };
+
+    static_assert (sizeof (Half) == 2, "Half has to be exactly 16 bits");
+
+    /** int16 samples cover [-int16FullScale, int16FullScale), so a feedback build-up has 6dB of room before it clips. */
+    constexpr float int16FullScale = 2.0f;
+    constexpr float int16ToFloat = int16FullScale / 32768.0f;
+    constexpr float floatToInt16 = 32768.0f / int16FullScale;
+
+    //==============================================================================
+    inline float toFloat (Half half) noexcept
+    {
+        // Moves the bits into place and fixes up the exponent, with special cases for infinities, NaNs and subnormals
+        constexpr juce::uint32 shiftedExponent = 0x7c00u << 13;
+        const juce::uint32 magicBits = 113u << 23;
+        float magic;
+        std::memcpy (&magic, &magicBits, sizeof (magic));
+
+        juce::uint32 bits = ((juce::uint32) half.bits & 0x7fffu) << 13;
+        const juce::uint32 exponent = bits & shiftedExponent;
+        bits += (127u - 15u) << 23;
+
+        float result;
+
+        if (exponent == shiftedExponent)
+        {
+            bits += (128u - 16u) << 23;
+            std::memcpy (&result, &bits, sizeof (result));
+        }
+        else if (exponent == 0)
+        {
+            bits += 1u << 23;
+            std::memcpy (&result, &bits, sizeof (result));
+            result -= magic;
+        }
+        else
+        {
+            std::memcpy (&result, &bits, sizeof (result));
+        }
+
+        juce::uint32 resultBits;
+        std::memcpy (&resultBits, &result, sizeof (resultBits));
+        resultBits |= ((juce::uint32) half.bits & 0x8000u) << 16;
+        std::memcpy (&result, &resultBits, sizeof (result));
+        return result;
+    }
+
+    inline Half toHalf (float value) noexcept
+    {
+        // Rounds to nearest even, the same as the hardware conversions
+        juce::uint32 bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+
+        const juce::uint32 sign = bits & 0x80000000u;
+        bits ^= sign;
+
+        juce::uint32 result;
+
+        if (bits >= (127u + 16u) << 23)                  // Too big, infinite or NaN
+        {
+            result = bits > (255u << 23) ? 0x7e00u : 0x7c00u;
+        }
+        else if (bits < 113u << 23)                      // Subnormal or zero - let a float add do the rounding
+        {
+            const juce::uint32 magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+            float magic, shifted;
+            std::memcpy (&magic, &magicBits, sizeof (magic));
+            std::memcpy (&shifted, &bits, sizeof (shifted));
+            shifted += magic;
+            std::memcpy (&result, &shifted, sizeof (result));
+            result -= magicBits;
+        }
+        else
+        {
+            const juce::uint32 mantissaIsOdd = (bits >> 13) & 1u;
+            bits += ((juce::uint32) (15 - 127) << 23) + 0xfffu + mantissaIsOdd;
+            result = bits >> 13;
+        }
+
+        return { (juce::uint16) (result | (sign >> 16)) };
+    }
+
+    inline float toFloat (juce::int16 sample) noexcept     { return (float) sample * int16ToFloat; }
+
+    inline juce::int16 toInt16 (float value) noexcept
+    {
+        return (juce::int16) juce::roundToInt (juce::jlimit (-32768.0f, 32767.0f, value * floatToInt16));
+    }
+
+    //==============================================================================
+    /** Converts num samples for storing. */
+    void convert (juce::int16* dest, const float* source, int num) noexcept;
+    void convert (Half* dest, const float* source, int num) noexcept;
+}
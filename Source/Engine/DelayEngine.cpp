@@ -0,0 +1,668 @@
+#include "DelayEngine.h"
+
+namespace
+{
+    // Runs the tap kernel over whichever format the line is stored in
+    void addTapsFromLine (float* output, int numSamples, const DelayLine& line, int channel, int readOrigin,
+                          const int* delays, const float* gains, int numTaps) noexcept
+    {
+        switch (line.getSampleFormat())
+        {
+            case DelayLine::SampleFormat::float16:
+                MultiTapKernel::addTaps (output, numSamples, line.getHalfReadPointer (channel), line.getMask(), readOrigin, delays, gains, numTaps);
+                break;
+
+            case DelayLine::SampleFormat::int16:
+                MultiTapKernel::addTaps (output, numSamples, line.getInt16ReadPointer (channel), line.getMask(), readOrigin, delays, gains, numTaps);
+                break;
+
+            case DelayLine::SampleFormat::float32:
+            default:
+                MultiTapKernel::addTaps (output, numSamples, line.getReadPointer (channel), line.getMask(), readOrigin, delays, gains, numTaps);
+                break;
+        }
+    }
+
+    void addModulatedTapsFromLine (float* output, int numSamples, const DelayLine& line, int channel, int readOrigin,
+                                   const MultiTapKernel::ModulatedTaps& taps, const float* glide, const float* offsets,
+                                   MultiTapKernel::Interpolation interpolation) noexcept
+    {
+        const int mask = line.getMask(), maximumDelay = line.getMaximumDelay();
+
+        switch (line.getSampleFormat())
+        {
+            case DelayLine::SampleFormat::float16:
+                MultiTapKernel::addModulatedTaps (output, numSamples, line.getHalfReadPointer (channel), mask, readOrigin, taps, glide, offsets, maximumDelay, interpolation);
+                break;
+
+            case DelayLine::SampleFormat::int16:
+                MultiTapKernel::addModulatedTaps (output, numSamples, line.getInt16ReadPointer (channel), mask, readOrigin, taps, glide, offsets, maximumDelay, interpolation);
+                break;
+
+            case DelayLine::SampleFormat::float32:
+            default:
+                MultiTapKernel::addModulatedTaps (output, numSamples, line.getReadPointer (channel), mask, readOrigin, taps, glide, offsets, maximumDelay, interpolation);
+                break;
+        }
+    }
+}
+
+//==============================================================================
+void DelayEngine::prepare (double newSampleRate, int newMaximumBlockSize, int newNumChannels)
+{
+    sampleRate = (int) newSampleRate;
+    maximumBlockSize = juce::jmax (1, newMaximumBlockSize);
+    numChannels = juce::jmax (1, newNumChannels);
+
+    // A fresh line, just long enough for the taps we've got so far
+    publishDelayLine (false);
+
+    convolutionLayout = PartitionedConvolver::createLayout ((int) (maximumDelayTimeS * sampleRate));
+
+    // Only rebuilt if something's needed one already - otherwise it waits for the first dense table
+    if (hasConvolver)
+        publishConvolver();
+
+    feedbackBuffer.setSize (numChannels, maximumBlockSize);
+    crossfadeBuffer.setSize (numChannels, maximumBlockSize);
+    movementBuffer.setSize (2, maximumBlockSize);
+    crossfadeLength = juce::jmax (1, juce::roundToInt (crossfadeTimeS * sampleRate));
+}
+
+void DelayEngine::setWorkerPool (AudioWorkerPool* pool)
+{
+    workerPool = pool;
+}
+
+void DelayEngine::reset()
+{
+    clearPending = true;
+}
+
+void DelayEngine::setTaps (const juce::Array<float>& delayTimesMS, const juce::Array<float>& delayGains, float feedback)
+{
+    setTaps (createTapTable (delayTimesMS, delayGains, feedback));
+}
+
+TapTable::Ptr DelayEngine::createTapTable (const juce::Array<float>& delayTimesMS, const juce::Array<float>& delayGains, float feedback)
+{
+    for (auto timeMS : delayTimesMS)
+        longestTapMS = juce::jmax (longestTapMS, timeMS);
+
+    // Grow the line before the taps that need it are published, so the audio thread picks it up first
+    if (getRequiredLineDelay() > lineMaximumDelay)
+        publishDelayLine (true);
+
+    // Copy the arrays into a new immutable table rather than letting the audio thread read them while they're edited
+    TapTable::Ptr table = new TapTable (delayTimesMS, delayGains, feedback, sampleRate, convolutionLayout, interpolation);
+
+    // The convolver's buffers cover the whole maximumDelayTimeS, so it's only made once a table needs it -
+    // and, like a bigger line, published before that table can be
+    if (table->convolution != nullptr && ! hasConvolver)
+        publishConvolver();
+
+    return table;
+}
+
+void DelayEngine::setTaps (TapTable::Ptr table)
+{
+    jassert (table != nullptr); // Publish an empty table rather than nothing
+
+    // The table the audio thread was using gets released back here, never in the callback
+    tapExchange.publish (table);
+    collectGarbage();
+}
+
+bool DelayEngine::scheduleTaps (TapTable::Ptr table, juce::int64 sampleTime)
+{
+    jassert (table != nullptr);
+    return tapExchange.schedule (table, sampleTime);
+}
+
+juce::int64 DelayEngine::getSampleTimeFor (double millisecondCounter) const noexcept
+{
+    // A seqlock - the audio thread never waits, and this just reads again if it caught a stamp half written
+    juce::int64 position;
+    double stampTimeMS;
+    juce::uint32 version;
+
+    do
+    {
+        version = stampVersion.load (std::memory_order_acquire);
+        position = stampedPosition.load (std::memory_order_relaxed);
+        stampTimeMS = stampedTimeMS.load (std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_acquire);
+    }
+    while ((version & 1) != 0 || stampVersion.load (std::memory_order_relaxed) != version);
+
+    // Everything up to the stamped position has been worked out already, so a time just after the stamp
+    // lands in the next block - a block late, but the same distance from every other time given here
+    const auto samplesSinceStamp = (juce::int64) std::floor ((millisecondCounter - stampTimeMS) * sampleRate / 1000.0);
+
+    // With no audio running the stamp stops moving, and anything given now should happen as soon as it starts again
+    if (samplesSinceStamp > 2 * maximumBlockSize + sampleRate / 10)
+        return position;
+
+    return position + juce::jmax ((juce::int64) 0, samplesSinceStamp);
+}
+
+void DelayEngine::stampBlockEnd (double startTimeMS) noexcept
+{
+    const auto version = stampVersion.load (std::memory_order_relaxed);
+    stampVersion.store (version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    stampedPosition.store (samplePosition, std::memory_order_relaxed);
+    stampedTimeMS.store (startTimeMS, std::memory_order_relaxed);
+
+    stampVersion.store (version + 2, std::memory_order_release);
+}
+
+void DelayEngine::setModulation (float rateHz, float depthMS)
+{
+    depthMS = juce::jlimit (0.0f, maximumModulationDepthMS, depthMS);
+
+    // The stretched taps need room in the line too - as with the taps themselves, it only grows
+    if (depthMS > modulationHeadroomMS)
+    {
+        modulationHeadroomMS = depthMS;
+
+        if (getRequiredLineDelay() > lineMaximumDelay)
+            publishDelayLine (true);
+    }
+
+    modulationRateHz = juce::jmax (0.0f, rateHz);
+    modulationDepthMS = depthMS;
+}
+
+void DelayEngine::setSampleFormat (DelayLine::SampleFormat newFormat)
+{
+    if (newFormat == sampleFormat)
+        return;
+
+    sampleFormat = newFormat;
+
+    // The replacement line converts the old one's history, a piece at a time, so the echoes carry on through the switch
+    publishDelayLine (true);
+    collectGarbage();
+}
+
+double DelayEngine::getTailLengthSeconds (const juce::Array<float>& delayTimesMS, float feedback, float modulationDepthMS)
+{
+    float longestTapMS = 0.0f;
+
+    for (auto timeMS : delayTimesMS)
+        longestTapMS = juce::jmax (longestTapMS, timeMS);
+
+    double seconds = (longestTapMS + modulationDepthMS) / 1000.0;
+
+    // Each trip round the feedback loop takes no longer than the longest tap and loses at least
+    // (1 - feedback) of the level, so keep going for enough trips to be 60dB down
+    if (feedback > 0.0f)
+        seconds *= 1.0 + std::ceil (std::log (0.001) / std::log ((double) juce::jmin (feedback, TapTable::maximumFeedback)));
+
+    return seconds;
+}
+
+void DelayEngine::collectGarbage()
+{
+    tapExchange.collectGarbage();
+    lineExchange.collectGarbage();
+    convolverExchange.collectGarbage();
+}
+
+void DelayEngine::publishDelayLine (bool continuesHistory)
+{
+    auto* line = new DelayLine (numChannels, getRequiredLineDelay(), maximumBlockSize, continuesHistory, sampleFormat);
+    lineMaximumDelay = line->getMaximumDelay();
+    lineSizeInBytes = line->getSizeInBytes();
+    lineExchange.publish (line);
+}
+
+void DelayEngine::publishConvolver()
+{
+    auto* state = new ConvolverState();
+    state->convolver.prepare (convolutionLayout, numChannels);
+    hasConvolver = true;
+    convolverExchange.publish (state);
+}
+
+int DelayEngine::getRequiredLineDelay() const noexcept
+{
+    // Plus the samples after the longest tap that interpolating it reads
+    return (int) std::ceil ((longestTapMS + modulationHeadroomMS) * (float) sampleRate / 1000.0f) + 3;
+}
+
+//==============================================================================
+void DelayEngine::process (juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // A decaying feedback tail ends up full of denormals, which are very slow on x86 - flush them to zero instead
+    juce::ScopedNoDenormals noDenormals;
+
+    fillTicks.store (0, std::memory_order_relaxed);
+    readTicks.store (0, std::memory_order_relaxed);
+
+    const auto startTimeMS = juce::Time::getMillisecondCounterHiRes();
+
+    // Anything longer than prepare() was told about goes through in pieces, so every read fits in the line's guard region
+    for (int done = 0; done < numSamples; done += maximumBlockSize)
+        processBlock (buffer, startSample + done, juce::jmin (maximumBlockSize, numSamples - done));
+
+    // Where this call got to and when it started, so the editing thread can turn its own times into samples
+    stampBlockEnd (startTimeMS);
+}
+
+void DelayEngine::processBlock (juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // If the channels go out to the worker pool, they need to be back before the next block is due
+    const auto deadlineTicks = juce::Time::getHighResolutionTicks()
+                                 + juce::Time::secondsToHighResolutionTicks (numSamples / (double) sampleRate);
+
+    // Pick up the latest taps and delay line - this never locks or allocates.
+    // The taps come first, so a line published along with them is always picked up too.
+    bool tapsChanged = acquireTaps();
+
+    // A bigger line takes over the audio from the one it replaces. Even as memcpys that's far too much for one
+    // block when the line is long, so the old line carries on until it's been copied across in pieces.
+    auto* line = lineExchange.acquireKeepingPrevious (samplePosition, [this] (DelayLine& previous, DelayLine& next)
+    {
+        if (! next.continuesHistory())
+            return;
+
+        isCopyingHistory = true;
+        historyCopiedTo = writeCounter - (juce::uint32) juce::jmin (next.getLength(), previous.getMaximumDelay());
+    });
+
+    if (line == nullptr) // Not prepared yet
+        return;
+
+    // A new convolver starts from nothing, the same as it does for new taps
+    auto* convolverState = convolverExchange.acquire();
+    auto* newConvolver = convolverState != nullptr ? &convolverState->convolver : nullptr;
+
+    if (newConvolver != convolver)
+    {
+        convolver = newConvolver;
+        tapsChanged = true;
+    }
+
+    if (clearPending.exchange (false))
+    {
+        line->clear();
+        isCopyingHistory = false; // Nothing left worth copying
+
+        if (convolver != nullptr)
+            convolver->reset();
+    }
+
+    if (isCopyingHistory)
+        isCopyingHistory = ! copyHistory (*lineExchange.getPrevious(), *line);
+
+    if (isCopyingHistory)
+        line = lineExchange.getPrevious();
+    else
+        lineExchange.releasePrevious();
+
+    // Scheduled changes split the block, so each one starts on exactly the sample it was given
+    for (int done = 0; done < numSamples;)
+    {
+        if (done > 0)
+            tapsChanged = acquireTaps();
+
+        const int segmentLength = getSegmentLength (numSamples - done);
+        processSegment (buffer, *line, tapsChanged, startSample + done, segmentLength, deadlineTicks);
+        done += segmentLength;
+    }
+}
+
+bool DelayEngine::copyHistory (const DelayLine& from, DelayLine& to) noexcept
+{
+    // Anything the old line's longest delay can't reach is about to be written over there, and no tap can hear it anyway
+    const auto oldest = writeCounter - (juce::uint32) from.getMaximumDelay();
+
+    if ((juce::int32) (historyCopiedTo - oldest) < 0)
+        historyCopiedTo = oldest;
+
+    // A few blocks' worth each time, so it always catches up with what's being written but costs about the same
+    // share of the block at any block size or channel count. Converting a format is slower than moving bits.
+    const int blocksPerBlock = from.getSampleFormat() == to.getSampleFormat() ? historyCopyBlocksPerBlock : historyConversionBlocksPerBlock;
+    const auto num = juce::jmin (writeCounter - historyCopiedTo, (juce::uint32) (maximumBlockSize * blocksPerBlock));
+
+    to.copyHistoryFrom (from, historyCopiedTo, historyCopiedTo + num);
+    historyCopiedTo += num;
+
+    return historyCopiedTo == writeCounter;
+}
+
+bool DelayEngine::acquireTaps() noexcept
+{
+    // The taps being replaced are kept until they've been faded out
+    bool tapsChanged = false;
+
+    tapExchange.acquireKeepingPrevious (samplePosition, [this, &tapsChanged] (TapTable& previous, TapTable& next)
+    {
+        tapsChanged = true;
+
+        // Taps that have only been nudged (e.g. dragged) slide across instead - no faster than one sample per sample
+        isGliding = next.canGlideFrom (previous, crossfadeLength);
+    });
+
+    if (tapsChanged)
+        crossfadePosition = 0;
+
+    return tapsChanged;
+}
+
+int DelayEngine::getSegmentLength (int numSamplesLeft) const noexcept
+{
+    const auto nextChange = tapExchange.getNextScheduledTime();
+
+    if (nextChange >= samplePosition + numSamplesLeft)
+        return numSamplesLeft;
+
+    // A change can't start until the last one has finished fading - whether it fell due in an earlier
+    // block (while a fade carried across the boundary) or falls in this one, it starts where the fade ends
+    if (tapExchange.getPrevious() != nullptr)
+    {
+        const int fadeLeft = crossfadeLength - crossfadePosition;
+        return fadeLeft > 0 ? juce::jmin (numSamplesLeft, fadeLeft) : numSamplesLeft;
+    }
+
+    // Already due but not taken (there was no room to hand anything back) - it'll go at the next block
+    if (nextChange <= samplePosition)
+        return numSamplesLeft;
+
+    return (int) (nextChange - samplePosition);
+}
+
+void DelayEngine::processSegment (juce::AudioBuffer<float>& buffer, DelayLine& line, bool tapsChanged,
+                                  int startSample, int numSamples, juce::int64 deadlineTicks)
+{
+    auto* taps = tapExchange.getCurrent();
+
+    // Stale tables are skipped until the new rate's have been published
+    const ActiveTaps current (taps, line, sampleRate);
+    const ActiveTaps fading (tapExchange.getPrevious(), line, sampleRate);
+
+    // Feedback is worked out a whole block at a time from what's already in the line,
+    // so the block gets split up until no piece is longer than the shortest feedback tap
+    const int maximumSubBlock = juce::jmin (numSamples, current.getMaximumSubBlock(), fading.getMaximumSubBlock());
+
+    // Moving taps are read one at a time, so the convolver sits out while the LFO's running
+    const auto movement = prepareMovement (numSamples, fading.table != nullptr);
+    const bool convolverChanged = tapsChanged || movement.isModulating != wasModulating;
+    wasModulating = movement.isModulating;
+
+    for (int done = 0; done < numSamples; done += maximumSubBlock)
+    {
+        const int subBlockLength = juce::jmin (maximumSubBlock, numSamples - done);
+
+        if (convolver != nullptr)
+            convolver->beginBlock (taps != nullptr && ! movement.isModulating ? taps->convolution.get() : nullptr, convolverChanged && done == 0);
+
+        processSubBlock (buffer, line, current, fading, movement.startingAt (done), startSample + done, subBlockLength, deadlineTicks);
+    }
+
+    // Once the old taps have faded right out (or were never usable) they can go back to be released
+    if (fading.table == nullptr || crossfadePosition >= crossfadeLength)
+        tapExchange.releasePrevious();
+}
+
+DelayEngine::ActiveTaps::ActiveTaps (const TapTable* taps, const DelayLine& line, int sampleRate) noexcept
+{
+    if (taps == nullptr || taps->sampleRate != sampleRate)
+        return;
+
+    table = taps;
+
+    // The line is always published before the taps that need it, but just in case, leave out any tap it can't reach yet
+    numUsable = taps->size();
+
+    if (taps->getMaximumDelay() > line.getMaximumDelay())
+        numUsable = (int) (std::upper_bound (taps->delaySamples.begin(), taps->delaySamples.end(), line.getMaximumDelay())
+                            - taps->delaySamples.begin());
+
+    hasFeedback = ! taps->feedbackDelays.isEmpty() && taps->getMaximumFeedbackDelay() <= line.getMaximumDelay();
+}
+
+DelayEngine::TapMovement DelayEngine::prepareMovement (int numSamples, bool isFading) noexcept
+{
+    float* glide = movementBuffer.getWritePointer (0);
+    float* offsets = movementBuffer.getWritePointer (1);
+    TapMovement movement { glide, offsets, isFading && isGliding, false };
+
+    // A glide follows the same ramp a crossfade would have, carrying on across sub-blocks
+    if (movement.isGliding)
+    {
+        const float step = 1.0f / (float) crossfadeLength;
+
+        for (int i = 0; i < numSamples; ++i)
+            glide[i] = juce::jmin (1.0f, (float) (crossfadePosition + i + 1) * step);
+    }
+    else
+    {
+        juce::FloatVectorOperations::fill (glide, 1.0f, numSamples);
+    }
+
+    // The LFO goes from 0 to the full depth and back, so it only ever lengthens taps and never pushes one below zero
+    const float targetDepth = modulationDepthMS.load (std::memory_order_relaxed) * (float) sampleRate / 1000.0f;
+
+    if (targetDepth > 0.0f || modulationDepth > 0.0f)
+    {
+        movement.isModulating = true;
+
+        const float depthStep = (targetDepth - modulationDepth) / (float) numSamples;
+        const double phaseStep = juce::MathConstants<double>::twoPi * modulationRateHz.load (std::memory_order_relaxed) / sampleRate;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            modulationDepth += depthStep;
+            offsets[i] = modulationDepth * 0.5f * (1.0f - (float) std::cos (modulationPhase));
+            modulationPhase += phaseStep;
+        }
+
+        modulationPhase = std::fmod (modulationPhase, juce::MathConstants<double>::twoPi);
+        modulationDepth = targetDepth; // Exactly, so it really does stop when it's turned off
+    }
+    else
+    {
+        juce::FloatVectorOperations::clear (offsets, numSamples);
+    }
+
+    return movement;
+}
+
+void DelayEngine::processSubBlock (juce::AudioBuffer<float>& buffer, DelayLine& line, const ActiveTaps& taps, const ActiveTaps& fadingTaps,
+                                   const TapMovement& movement, int startSample, int numSamples, juce::int64 deadlineTicks)
+{
+    // The mask does the wrapping that used to need a % (and an explanation)
+    const int writePosition = (int) (writeCounter & (juce::uint32) line.getMask());
+    const int numChannelsToProcess = juce::jmin (buffer.getNumChannels(), line.getNumChannels());
+    const bool isFading = fadingTaps.table != nullptr;
+    const bool crossfadesOutput = isFading && ! movement.isGliding; // The feedback always crossfades
+
+    // Channels never touch each other's state, so they can all run at once
+    auto processChannel = [&] (int channel)
+    {
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        float* bufferData = buffer.getWritePointer(channel, startSample);
+        float* fadingData = crossfadeBuffer.getWritePointer (channel);
+
+        const float* lineInput = bufferData;
+
+        // A compact line can't be convolved straight out of, so its input gets kept as floats as well
+        if (taps.hasFeedback || fadingTaps.hasFeedback || line.isCompact())
+        {
+            // What goes into the line is the dry input plus any fed back taps
+            float* feedbackData = feedbackBuffer.getWritePointer (channel);
+            feedbackDelay(line, taps, channel, writePosition, bufferData, feedbackData, numSamples);
+
+            if (isFading)
+            {
+                feedbackDelay(line, fadingTaps, channel, writePosition, bufferData, fadingData, numSamples);
+                crossfade(feedbackData, fadingData, numSamples);
+            }
+
+            fillDelayBuffer(line, channel, writePosition, feedbackData, numSamples);
+            lineInput = feedbackData;
+        }
+        else
+        {
+            fillDelayBuffer(line, channel, writePosition, bufferData, numSamples);
+        }
+
+        const auto filledTicks = juce::Time::getHighResolutionTicks();
+
+        // The old taps all go through the kernel - the convolver has already moved on to the new ones
+        if (crossfadesOutput)
+        {
+            juce::FloatVectorOperations::copy (fadingData, bufferData, numSamples);
+            getAllFromDelayBuffer(line, fadingTaps, movement, channel, writePosition, fadingData, numSamples);
+        }
+
+        if (taps.table != nullptr)
+        {
+            if (movement.isGliding || movement.isModulating)
+            {
+                getMovingFromDelayBuffer(line, movement.isGliding ? *fadingTaps.table : *taps.table, *taps.table, movement,
+                                         channel, writePosition, bufferData, numSamples);
+            }
+            else
+            {
+                if (taps.table->convolution != nullptr && convolver != nullptr)
+                    convolveFromDelayBuffer(line, channel, writePosition, lineInput != bufferData ? lineInput : nullptr, bufferData, numSamples);
+
+                getFromDelayBuffer(line, *taps.table, taps.numUsable, channel, writePosition, bufferData, numSamples);
+            }
+        }
+
+        if (crossfadesOutput)
+            crossfade(bufferData, fadingData, numSamples);
+
+        fillTicks.fetch_add (filledTicks - startTicks, std::memory_order_relaxed);
+        readTicks.fetch_add (juce::Time::getHighResolutionTicks() - filledTicks, std::memory_order_relaxed);
+    };
+
+    // Handing channels to other threads costs a few microseconds, so only do it when there's plenty to share
+    auto getWork = [numSamples] (const ActiveTaps& t)
+    {
+        return t.table == nullptr ? 0 : (juce::int64) (t.numUsable + t.table->feedbackDelays.size()) * numSamples;
+    };
+
+    const bool worthParallelising = workerPool != nullptr && numChannelsToProcess > 1 && taps.table != nullptr
+                                     && (taps.table->convolution != nullptr
+                                          || getWork (taps) + getWork (fadingTaps) >= minimumParallelWork);
+
+    if (worthParallelising)
+    {
+        if (! workerPool->parallelFor (numChannelsToProcess, deadlineTicks, processChannel))
+            ++numMissedDeadlines;
+    }
+    else
+    {
+        for (int channel = 0; channel < numChannelsToProcess; ++channel)
+            processChannel (channel);
+    }
+
+    writeCounter += (juce::uint32) numSamples;
+    samplePosition += numSamples;
+
+    if (isFading)
+        crossfadePosition = juce::jmin (crossfadeLength, crossfadePosition + numSamples);
+}
+
+//==============================================================================
+void DelayEngine::fillDelayBuffer(DelayLine& line, int channel, int writePosition, const float* bufferData, const int bufferLength)
+{
+    // Copy data from main buffer to delay buffer - the line deals with wrapping round and keeping its guard region up to date
+    line.write (channel, writePosition, bufferData, bufferLength);
+}
+
+void DelayEngine::getFromDelayBuffer(const DelayLine& line, const TapTable& taps, int numUsableTaps, int channel, int writePosition, float* bufferData, const int bufferLength)
+{
+    // Add the delayed values back to the main buffer.
+    // The kernel does every tap in one pass over the block, rather than one addFromWithRamp per tap (and two when it wrapped).
+    // Taps in a stage the convolver is already handling are skipped, joining up whatever's left into as few runs as possible.
+    int runStart = 0;
+
+    auto addRun = [&] (int runEnd)
+    {
+        runEnd = juce::jmin (runEnd, numUsableTaps);
+
+        if (runEnd > runStart)
+            addTapsFromLine (bufferData, bufferLength, line, channel, writePosition,
+                             taps.delaySamples.begin() + runStart, taps.delayGains.begin() + runStart, runEnd - runStart);
+    };
+
+    if (taps.convolution != nullptr && convolver != nullptr)
+    {
+        for (int stage = 0; stage < convolver->getNumStages(); ++stage)
+        {
+            if (taps.convolution->usesStage (stage) && convolver->isStageReady (stage))
+            {
+                addRun (taps.stageTapStart.getUnchecked (stage));
+                runStart = taps.stageTapStart.getUnchecked (stage + 1);
+            }
+        }
+    }
+
+    addRun (taps.size());
+}
+
+void DelayEngine::getAllFromDelayBuffer(const DelayLine& line, const ActiveTaps& taps, const TapMovement& movement, int channel, int writePosition, float* bufferData, const int bufferLength)
+{
+    if (movement.isModulating)
+    {
+        getMovingFromDelayBuffer(line, *taps.table, *taps.table, movement, channel, writePosition, bufferData, bufferLength);
+        return;
+    }
+
+    addTapsFromLine (bufferData, bufferLength, line, channel, writePosition,
+                     taps.table->delaySamples.begin(), taps.table->delayGains.begin(), taps.numUsable);
+}
+
+void DelayEngine::getMovingFromDelayBuffer(const DelayLine& line, const TapTable& from, const TapTable& to, const TapMovement& movement, int channel, int writePosition, float* bufferData, const int bufferLength)
+{
+    // Every tap glides from where it was in the old table to where it is in the new one (the same place, if they're
+    // the same table), then gets stretched by the LFO - all worked out a sample at a time inside the kernel
+    const MultiTapKernel::ModulatedTaps moving { from.exactDelays.begin(), to.exactDelays.begin(),
+                                                 from.exactGains.begin(), to.exactGains.begin(), to.exactDelays.size() };
+
+    addModulatedTapsFromLine (bufferData, bufferLength, line, channel, writePosition, moving,
+                              movement.glide, movement.offsets, to.interpolation);
+}
+
+void DelayEngine::convolveFromDelayBuffer(const DelayLine& line, int channel, int writePosition, const float* lineInput, float* bufferData, const int bufferLength)
+{
+    // The convolver's input is what we've just written to the delay line - thanks to the guard region that's one straight run.
+    // A compact line's copy has been rounded, so the float version it was made from gets used instead.
+    if (lineInput == nullptr)
+        lineInput = line.getReadPointer (channel) + writePosition;
+
+    convolver->process (channel, lineInput, bufferData, bufferLength);
+}
+
+void DelayEngine::feedbackDelay(const DelayLine& line, const ActiveTaps& taps, int channel, int writePosition, const float* dryBuffer, float* lineInput, const int bufferLength)
+{
+    // Every feedback tap is at least a block long, so this only reads audio written by earlier blocks -
+    // the same kernel as the output taps, just accumulating on top of the dry signal
+    juce::FloatVectorOperations::copy (lineInput, dryBuffer, bufferLength);
+
+    if (taps.hasFeedback)
+        addTapsFromLine (lineInput, bufferLength, line, channel, writePosition,
+                         taps.table->feedbackDelays.begin(), taps.table->feedbackGains.begin(), taps.table->feedbackDelays.size());
+}
+
+void DelayEngine::crossfade(float* bufferData, const float* fadingData, const int bufferLength) const noexcept
+{
+    // A linear ramp from the old taps' output (already in fadingData) to the new taps' (in bufferData),
+    // carrying on from wherever the last sub-block left off
+    const float step = 1.0f / (float) crossfadeLength;
+    float gain = (float) crossfadePosition * step;
+
+    for (int i = 0; i < bufferLength; ++i)
+    {
+        gain = juce::jmin (1.0f, gain + step);
+        bufferData[i] = fadingData[i] + gain * (bufferData[i] - fadingData[i]);
+    }
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "SnapshotExchange.h"
+#include "TapTable.h"
+#include "DelayLine.h"
+#include "MultiTapKernel.h"
+#include "PartitionedConvolver.h"
+#include "AudioWorkerPool.h"
+
+//==============================================================================
+/*
+    The multi-tap delay itself, pulled out of MainComponent so the same code can be
+    driven by the audio device or by the command-line batch renderer.
+
+    Call prepare() while no audio is running, prepare()/setTaps()/reset() from one
+    "editing" thread (normally the message thread) and process() from the audio thread.
+*/
+class DelayEngine
+{
+public:
+    //==============================================================================
+    DelayEngine() = default;
+
+    void prepare (double sampleRate, int maximumBlockSize, int numChannels);
+
+    /** Lets process() spread the channels over a shared pool of threads when a block has
+        enough work in it. Call while no audio is running; nullptr (the default) keeps
+        everything on the calling thread.
+    */
+    void setWorkerPool (AudioWorkerPool* pool);
+
+    /** Where the time went in the last process() call, in high resolution ticks summed over every channel. */
+    struct ProcessTimes
+    {
+        juce::int64 fillTicks;  // Writing the input (and any feedback) into the delay line
+        juce::int64 readTicks;  // Adding the taps back out of it, directly or by convolution
+    };
+
+    /** Audio thread: only valid straight after process() returns. */
+    ProcessTimes getLastProcessTimes() const noexcept
+    {
+        return { fillTicks.load (std::memory_order_relaxed), readTicks.load (std::memory_order_relaxed) };
+    }
+
+    /** How many blocks the worker pool has handed back later than real time allows. */
+    int getNumMissedDeadlines() const noexcept    { return numMissedDeadlines.load(); }
+
+    /** Clears the delay line at the start of the next block. */
+    void reset();
+
+    /** Publishes a new set of taps, converted for the sample rate given to prepare().
+        Dense patterns are switched over to FFT convolution automatically, and if a tap is
+        longer than the delay line can hold a bigger line is built here and handed over too.
+
+        feedback is the loop gain (0 to TapTable::maximumFeedback) shared between the loudest
+        taps, which then write back into the delay line as well as playing out.
+    */
+    void setTaps (const juce::Array<float>& delayTimesMS, const juce::Array<float>& delayGains, float feedback = 0.0f);
+
+    /** Does all the work of setTaps() except publishing, so a pattern can be compiled ahead of time
+        (e.g. when a preset is loaded) and switched to later for the cost of a pointer swap.
+        The delay line only ever grows here, so it stays long enough for every table made from it.
+        Tables are only valid for the current sample rate - make them again after prepare() changes it.
+    */
+    TapTable::Ptr createTapTable (const juce::Array<float>& delayTimesMS, const juce::Array<float>& delayGains, float feedback = 0.0f);
+
+    /** Publishes a table made by createTapTable(). Nothing is allocated or worked out here, and the
+        audio thread crossfades from the old taps to the new ones over crossfadeTimeS - or, if the
+        new taps are the old ones moved a little (see TapTable::canGlideFrom()), slides them across.
+    */
+    void setTaps (TapTable::Ptr table);
+
+    /** Like setTaps(), but the new table takes over on exactly the sample sampleTime (see getSampleTimeFor()),
+        which can be part way through a block - for replaying a gesture or automation with its timing intact.
+        Changes should be scheduled in order. One that comes less than crossfadeTimeS after the last has to
+        wait for that one to finish fading, and if several are waiting by then only the newest is used.
+        A plain setTaps() replaces everything scheduled before it.
+
+        Returns false if too many changes are already waiting, in which case nothing is scheduled.
+    */
+    bool scheduleTaps (TapTable::Ptr table, juce::int64 sampleTime);
+
+    /** Editing thread: the sample on which something happening at millisecondCounter
+        (from juce::Time::getMillisecondCounterHiRes()) should be heard.
+        That's a block after the audio thread last got to that time, so times given here keep their spacing.
+    */
+    juce::int64 getSampleTimeFor (double millisecondCounter) const noexcept;
+
+    /** Adds the delayed signal to numSamples of buffer, starting at startSample. */
+    void process (juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    int getSampleRate() const noexcept    { return sampleRate; }
+
+    /** How taps that fall between samples are read, for tables made from now on. */
+    void setInterpolation (TapTable::Interpolation newInterpolation)    { interpolation = newInterpolation; }
+    TapTable::Interpolation getInterpolation() const noexcept           { return interpolation; }
+
+    /** An LFO that stretches every tap by between 0 and depthMS, for chorus and tape-wobble effects.
+        Can be called from any thread; depth changes are smoothed over a block.
+        While it's running every tap is read a sample at a time by MultiTapKernel::addModulatedTaps(),
+        so a dense pattern loses its convolution and costs a lot more.
+    */
+    void setModulation (float rateHz, float depthMS);
+
+    /** Switches the delay line to another storage format (see DelayLine), keeping the audio already in it.
+        The 16-bit formats halve the line's memory for a little quantisation noise.
+    */
+    void setSampleFormat (DelayLine::SampleFormat newFormat);
+    DelayLine::SampleFormat getSampleFormat() const noexcept    { return sampleFormat; }
+
+    /** How long these taps keep sounding once the input stops: the longest tap (stretched by the LFO),
+        and with feedback as many trips round the loop as it takes to fall 60dB.
+    */
+    static double getTailLengthSeconds (const juce::Array<float>& delayTimesMS, float feedback, float modulationDepthMS = 0.0f);
+
+    /** Editing thread: frees the taps, lines and convolvers the audio thread has finished with.
+        Otherwise a line that's been grown or switched to another format stays allocated until the next one
+        is published, which might be never - so call this regularly, e.g. from a timer.
+    */
+    void collectGarbage();
+
+    /** The size of the newest delay line, for the editing thread. */
+    size_t getDelayLineSizeInBytes() const noexcept    { return lineSizeInBytes; }
+
+    static constexpr float maximumDelayTimeS = 5.0f;
+    static constexpr float crossfadeTimeS = 0.01f; // Between one set of taps and the next, so edits and preset changes don't click
+    static constexpr float maximumModulationDepthMS = 50.0f;
+
+private:
+    //==============================================================================
+    // A tap table as used for one block - how many of its taps the line can reach, and whether its feedback can run
+    struct ActiveTaps
+    {
+        ActiveTaps() = default;
+        ActiveTaps (const TapTable* table, const DelayLine& line, int sampleRate) noexcept;
+
+        const TapTable* table = nullptr;
+        int numUsable = 0;
+        bool hasFeedback = false;
+
+        int getMaximumSubBlock() const noexcept    { return hasFeedback ? table->getMaximumFeedbackBlock() : std::numeric_limits<int>::max(); }
+    };
+
+    // How the taps are moving this block: a per-sample ramp for gliding from the old taps to the new
+    // ones, and the LFO's per-sample stretch. Either one means the taps get read a sample at a time.
+    struct TapMovement
+    {
+        const float* glide;
+        const float* offsets;
+        bool isGliding, isModulating;
+
+        TapMovement startingAt (int offset) const noexcept    { return { glide + offset, offsets + offset, isGliding, isModulating }; }
+    };
+
+    TapMovement prepareMovement (int numSamples, bool isFading) noexcept;
+
+    void processBlock (juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void processSegment (juce::AudioBuffer<float>& buffer, DelayLine& line, bool tapsChanged, int startSample, int numSamples, juce::int64 deadlineTicks);
+    bool acquireTaps() noexcept;
+    bool copyHistory (const DelayLine& from, DelayLine& to) noexcept;
+    int getSegmentLength (int numSamplesLeft) const noexcept;
+    void stampBlockEnd (double startTimeMS) noexcept;
+    void processSubBlock (juce::AudioBuffer<float>& buffer, DelayLine& line, const ActiveTaps& taps, const ActiveTaps& fadingTaps,
+                          const TapMovement& movement, int startSample, int numSamples, juce::int64 deadlineTicks);
+    void publishDelayLine (bool continuesHistory);
+    void publishConvolver();
+    int getRequiredLineDelay() const noexcept;
+
+    void fillDelayBuffer(DelayLine& line, int channel, int writePosition, const float* bufferData, const int bufferLength);
+    void getFromDelayBuffer(const DelayLine& line, const TapTable& taps, int numUsableTaps, int channel, int writePosition, float* bufferData, const int bufferLength);
+    void getAllFromDelayBuffer(const DelayLine& line, const ActiveTaps& taps, const TapMovement& movement, int channel, int writePosition, float* bufferData, const int bufferLength);
+    void getMovingFromDelayBuffer(const DelayLine& line, const TapTable& from, const TapTable& to, const TapMovement& movement, int channel, int writePosition, float* bufferData, const int bufferLength);
+    void convolveFromDelayBuffer(const DelayLine& line, int channel, int writePosition, const float* lineInput, float* bufferData, const int bufferLength);
+
+    void feedbackDelay(const DelayLine& line, const ActiveTaps& taps, int channel, int writePosition, const float* dryBuffer, float* lineInput, const int bufferLength);
+    void crossfade(float* bufferData, const float* fadingData, const int bufferLength) const noexcept;
+
+    // Circular buffer - sized for the longest tap, and swapped for a bigger one when that grows
+    SnapshotExchange<DelayLine> lineExchange;
+    juce::uint32 writeCounter{ 0 }; // Never wraps by hand - masking it with the line's length gives the write position
+    std::atomic<bool> clearPending{ false };
+
+    // A new line is filled in this far ahead of each block, while the old one carries on - audio thread only
+    bool isCopyingHistory{ false };
+    juce::uint32 historyCopiedTo{ 0 };
+    static constexpr int historyCopyBlocksPerBlock = 16, historyConversionBlocksPerBlock = 4;
+
+    int sampleRate{ 44100 };
+    int maximumBlockSize{ 512 };
+    int numChannels{ 2 };
+
+    // Only used on the editing thread - the longest tap in any table made since prepare(), and the deepest modulation
+    float longestTapMS{ 0.0f };
+    float modulationHeadroomMS{ 0.0f };
+    TapTable::Interpolation interpolation{ TapTable::Interpolation::linear };
+    int lineMaximumDelay{ 0 };
+    size_t lineSizeInBytes{ 0 };
+    DelayLine::SampleFormat sampleFormat{ DelayLine::SampleFormat::float32 };
+
+    SnapshotExchange<TapTable> tapExchange;
+
+    // Counts every sample processed, for scheduling tap changes - audio thread only
+    juce::int64 samplePosition{ 0 };
+
+    // Where the last process() call got to, and when it started, written by the audio thread for getSampleTimeFor()
+    std::atomic<juce::uint32> stampVersion{ 0 };
+    std::atomic<juce::int64> stampedPosition{ 0 };
+    std::atomic<double> stampedTimeMS{ 0.0 };
+
+    // Dense taps get convolved instead - the layout only depends on the sample rate. The convolver's
+    // spectra take a few MB a channel, so it's made the first time a table needs it, and handed over like the line.
+    struct ConvolverState  : public juce::ReferenceCountedObject
+    {
+        PartitionedConvolver convolver;
+    };
+
+    std::vector<PartitionedConvolver::Stage> convolutionLayout;
+    SnapshotExchange<ConvolverState> convolverExchange;
+    PartitionedConvolver* convolver = nullptr; // Whichever one the audio thread last picked up
+    bool hasConvolver{ false };                // Editing thread only
+
+    // Scratch space for the line's input when there's feedback - the dry signal has to stay untouched for the output
+    juce::AudioBuffer<float> feedbackBuffer;
+
+    // While the taps change, the old ones are worked out into here and faded out under the new ones
+    juce::AudioBuffer<float> crossfadeBuffer;
+    int crossfadeLength{ 441 };
+    int crossfadePosition{ 0 }; // Samples since the last swap - audio thread only
+    bool isGliding{ false };    // Whether the last swap glides rather than crossfades - likewise
+
+    // The LFO's settings, and where it's got to on the audio thread
+    std::atomic<float> modulationRateHz{ 0.0f }, modulationDepthMS{ 0.0f };
+    double modulationPhase{ 0.0 };
+    float modulationDepth{ 0.0f }; // In samples, heading for modulationDepthMS
+    bool wasModulating{ false };
+    juce::AudioBuffer<float> movementBuffer; // The glide ramp and the LFO offsets, one channel each
+
+    AudioWorkerPool* workerPool = nullptr;
+    std::atomic<int> numMissedDeadlines{ 0 };
+    std::atomic<juce::int64> fillTicks{ 0 }, readTicks{ 0 }; // Atomic because channels can be running on the worker pool
+    static constexpr juce::int64 minimumParallelWork = 65536; // Taps times samples, per channel
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayEngine)
+};
@@ -0,0 +1,207 @@
+#include "DelayLine.h"
+
+namespace
+{
+    constexpr int alignmentBytes = 64;
+    constexpr int minimumGuardLength = 32; // The tap kernel works in 32-sample chunks
+
+    int roundUp (int value, int multiple) noexcept    { return (value + multiple - 1) / multiple * multiple; }
+
+    // Calls function (destIndex, sourceIndex, num) for each run of write-counter values in [start, end)
+    // that's contiguous in both rings - at most three, since each ring wraps at most once
+    template <typename Function>
+    void forEachRun (juce::uint32 mask, juce::uint32 sourceMask, juce::uint32 start, juce::uint32 end, Function&& function) noexcept
+    {
+        while (start != end)
+        {
+            const auto destIndex = start & mask, sourceIndex = start & sourceMask;
+            const auto num = juce::jmin (end - start, mask + 1 - destIndex, sourceMask + 1 - sourceIndex);
+
+            function ((int) destIndex, (int) sourceIndex, (int) num);
+            start += num;
+        }
+    }
+}
+
+//==============================================================================
+const char* DelayLine::getSampleFormatName (SampleFormat format) noexcept
+{
+    switch (format)
+    {
+        case SampleFormat::float32:   return "float32";
+        case SampleFormat::float16:   return "float16";
+        case SampleFormat::int16:     return "int16";
+        default:                      return "";
+    }
+}
+
+DelayLine::DelayLine (int numChannelsToUse, int maximumDelaySamples, int maximumBlockSize, bool continuesHistory, SampleFormat sampleFormat)
+    : numChannels (juce::jmax (1, numChannelsToUse)),
+      length (juce::nextPowerOfTwo (juce::jmax (64, maximumDelaySamples + roundUp (juce::jmax (maximumBlockSize, minimumGuardLength), minimumGuardLength)))),
+      guardLength (roundUp (juce::jmax (maximumBlockSize, minimumGuardLength), minimumGuardLength)),
+      keepsHistory (continuesHistory),
+      format (sampleFormat)
+{
+    // Pad each channel so the next one starts on an alignment boundary too
+    channelStride = roundUp (length + guardLength, alignmentBytes / (int) getBytesPerSample());
+
+    storage.calloc (getSizeInBytes() + alignmentBytes);
+    channels.malloc ((size_t) numChannels);
+
+    auto address = (reinterpret_cast<juce::pointer_sized_uint> (storage.get()) + alignmentBytes - 1) & ~(juce::pointer_sized_uint) (alignmentBytes - 1);
+    auto* start = reinterpret_cast<char*> (address);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        channels[channel] = start + (size_t) channel * (size_t) channelStride * getBytesPerSample();
+}
+
+//==============================================================================
+template <typename Operation>
+void DelayLine::writeWith (int channel, int position, int numSamples, Operation&& operation) noexcept
+{
+    jassert (numSamples <= guardLength);
+
+    position &= getMask();
+
+    // At most two pieces: up to the end of the ring, then round to the start
+    const int firstPart = juce::jmin (numSamples, length - position);
+
+    operation (position, 0, firstPart);
+    operation (0, firstPart, numSamples - firstPart);
+
+    refreshGuard (channel, position, firstPart);
+    refreshGuard (channel, 0, numSamples - firstPart);
+}
+
+void DelayLine::refreshGuard (int channel, int start, int numSamples) noexcept
+{
+    // Whatever was written into the first guardLength samples gets mirrored after the end
+    const int end = juce::jmin (start + numSamples, guardLength);
+
+    if (end > start)
+    {
+        const auto bytesPerSample = getBytesPerSample();
+        char* data = channels[channel];
+        std::memcpy (data + (size_t) (length + start) * bytesPerSample, data + (size_t) start * bytesPerSample,
+                     (size_t) (end - start) * bytesPerSample);
+    }
+}
+
+void DelayLine::write (int channel, int position, const float* source, int numSamples) noexcept
+{
+    writeWith (channel, position, numSamples, [this, channel, source] (int destIndex, int offset, int num)
+    {
+        writeRun (channel, destIndex, source + offset, num);
+    });
+}
+
+void DelayLine::add (int channel, int position, const float* source, int numSamples, float gain) noexcept
+{
+    writeWith (channel, position, numSamples, [this, channel, source, gain] (int destIndex, int offset, int num)
+    {
+        if (format == SampleFormat::float32)
+        {
+            juce::FloatVectorOperations::addWithMultiply (reinterpret_cast<float*> (channels[channel]) + destIndex, source + offset, gain, num);
+            return;
+        }
+
+        for (int i = 0; i < num; ++i)
+            setSample (channel, destIndex + i, getSample (channel, destIndex + i) + source[offset + i] * gain);
+    });
+}
+
+void DelayLine::clear() noexcept
+{
+    // All zero bits is silence in every format
+    for (int channel = 0; channel < numChannels; ++channel)
+        std::memset (channels[channel], 0, (size_t) (length + guardLength) * getBytesPerSample());
+}
+
+void DelayLine::copyHistoryFrom (const DelayLine& other, juce::uint32 start, juce::uint32 end) noexcept
+{
+    jassert (end - start <= (juce::uint32) juce::jmin (length, other.length));
+
+    const auto bytesPerSample = getBytesPerSample();
+
+    for (int channel = 0; channel < juce::jmin (numChannels, other.numChannels); ++channel)
+    {
+        // The same counter masked by each length lands on the same moment in time in both rings
+        forEachRun ((juce::uint32) getMask(), (juce::uint32) other.getMask(), start, end, [&] (int destIndex, int sourceIndex, int num)
+        {
+            if (other.format == format)
+            {
+                // Whatever the format, it's just bits to be moved
+                std::memcpy (channels[channel] + (size_t) destIndex * bytesPerSample,
+                             other.channels[channel] + (size_t) sourceIndex * bytesPerSample, (size_t) num * bytesPerSample);
+            }
+            else
+            {
+                // Through floats, a stack-sized piece at a time
+                float scratch[256];
+
+                for (int done = 0; done < num; done += juce::numElementsInArray (scratch))
+                {
+                    const int pieceLength = juce::jmin (num - done, juce::numElementsInArray (scratch));
+
+                    other.readRun (channel, sourceIndex + done, scratch, pieceLength);
+                    writeRun (channel, destIndex + done, scratch, pieceLength);
+                }
+            }
+
+            refreshGuard (channel, destIndex, num);
+        });
+    }
+}
+
+void DelayLine::readRun (int channel, int index, float* dest, int num) const noexcept
+{
+    if (format == SampleFormat::float32)
+    {
+        juce::FloatVectorOperations::copy (dest, reinterpret_cast<const float*> (channels[channel]) + index, num);
+        return;
+    }
+
+    for (int i = 0; i < num; ++i)
+        dest[i] = getSample (channel, index + i);
+}
+
+void DelayLine::writeRun (int channel, int index, const float* source, int num) noexcept
+{
+    switch (format)
+    {
+        case SampleFormat::float32:
+            juce::FloatVectorOperations::copy (reinterpret_cast<float*> (channels[channel]) + index, source, num);
+            break;
+
+        case SampleFormat::float16:
+            CompactSamples::convert (reinterpret_cast<CompactSamples::Half*> (channels[channel]) + index, source, num);
+            break;
+
+        case SampleFormat::int16:
+            CompactSamples::convert (reinterpret_cast<juce::int16*> (channels[channel]) + index, source, num);
+            break;
+    }
+}
+
+//==============================================================================
+float DelayLine::getSample (int channel, int index) const noexcept
+{
+    switch (format)
+    {
+        case SampleFormat::float16:   return CompactSamples::toFloat (reinterpret_cast<const CompactSamples::Half*> (channels[channel])[index]);
+        case SampleFormat::int16:     return CompactSamples::toFloat (reinterpret_cast<const juce::int16*> (channels[channel])[index]);
+        case SampleFormat::float32:
+        default:                      return reinterpret_cast<const float*> (channels[channel])[index];
+    }
+}
+
+void DelayLine::setSample (int channel, int index, float value) noexcept
+{
+    switch (format)
+    {
+        case SampleFormat::float16:   reinterpret_cast<CompactSamples::Half*> (channels[channel])[index] = CompactSamples::toHalf (value); break;
+        case SampleFormat::int16:     reinterpret_cast<juce::int16*> (channels[channel])[index] = CompactSamples::toInt16 (value); break;
+        case SampleFormat::float32:
+        default:                      reinterpret_cast<float*> (channels[channel])[index] = value; break;
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "CompactSamples.h"
+
+//==============================================================================
+/*
+    The circular buffer the taps read from.
+
+    The length is a power of two, so positions wrap with a mask instead of a branch
+    or a %, and each channel is followed by a guard region that mirrors the start of
+    the ring. Any read of up to a block starting anywhere in [0, length) is therefore
+    one contiguous run, so readers never have to split at the end of the buffer.
+
+    Channels start on 64-byte boundaries to keep SIMD loads from straddling cache lines.
+
+    The line is sized for the longest tap actually in use. When a longer tap comes
+    along the engine builds a bigger line on the message thread and hands it over
+    through a SnapshotExchange, so nothing is ever allocated in the audio callback.
+
+    Long lines at high sample rates can be kept as 16-bit samples instead of floats
+    (see CompactSamples), converted on the way in and again by the tap kernel on the
+    way out. That halves the memory every block's reads have to stream through.
+*/
+class DelayLine  : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<DelayLine>;
+
+    enum class SampleFormat
+    {
+        float32,
+        float16,
+        int16
+    };
+
+    static const char* getSampleFormatName (SampleFormat format) noexcept;
+
+    /** Makes a line that can hold maximumDelaySamples of history while blocks of up to maximumBlockSize are
+        written. A line with continuesHistory set takes over the audio of the line it replaces.
+    */
+    DelayLine (int numChannels, int maximumDelaySamples, int maximumBlockSize, bool continuesHistory,
+               SampleFormat format = SampleFormat::float32);
+
+    //==============================================================================
+    int getNumChannels() const noexcept    { return numChannels; }
+    int getLength() const noexcept         { return length; }
+    int getMask() const noexcept           { return length - 1; }
+    int getGuardLength() const noexcept    { return guardLength; }
+
+    /** The longest delay that can be read while a full block is being written. */
+    int getMaximumDelay() const noexcept   { return length - guardLength; }
+
+    bool continuesHistory() const noexcept { return keepsHistory; }
+
+    SampleFormat getSampleFormat() const noexcept    { return format; }
+    bool isCompact() const noexcept                  { return format != SampleFormat::float32; }
+
+    /** How much memory the samples take up, guard regions included. */
+    size_t getSizeInBytes() const noexcept           { return (size_t) channelStride * (size_t) numChannels * getBytesPerSample(); }
+
+    /** Start of a channel - anything in [0, getLength() + getGuardLength()) can be read.
+        Only use the one that matches getSampleFormat().
+    */
+    const float* getReadPointer (int channel) const noexcept
+    {
+        jassert (format == SampleFormat::float32);
+        return reinterpret_cast<const float*> (channels[channel]);
+    }
+
+    const CompactSamples::Half* getHalfReadPointer (int channel) const noexcept
+    {
+        jassert (format == SampleFormat::float16);
+        return reinterpret_cast<const CompactSamples::Half*> (channels[channel]);
+    }
+
+    const juce::int16* getInt16ReadPointer (int channel) const noexcept
+    {
+        jassert (format == SampleFormat::int16);
+        return reinterpret_cast<const juce::int16*> (channels[channel]);
+    }
+
+    //==============================================================================
+    /** Copies numSamples (no more than the guard length) in at position, which gets masked.
+        A compact line converts them as they go in.
+    */
+    void write (int channel, int position, const float* source, int numSamples) noexcept;
+
+    /** Mixes numSamples in at position, scaled by gain. */
+    void add (int channel, int position, const float* source, int numSamples, float gain) noexcept;
+
+    void clear() noexcept;
+
+    /** Takes over the audio the line this one is replacing was given between write counters start and end,
+        so that a write counter means the same place in both. Copying between lines in the same format is a
+        few memcpys per channel and converting between formats is much slower, but either way a long line is
+        meant to be taken over a piece at a time.
+    */
+    void copyHistoryFrom (const DelayLine& other, juce::uint32 start, juce::uint32 end) noexcept;
+
+private:
+    //==============================================================================
+    template <typename Operation>
+    void writeWith (int channel, int position, int numSamples, Operation&& operation) noexcept;
+
+    void refreshGuard (int channel, int start, int numSamples) noexcept;
+
+    size_t getBytesPerSample() const noexcept    { return format == SampleFormat::float32 ? sizeof (float) : 2; }
+
+    // A run that doesn't wrap, to or from floats
+    void readRun (int channel, int index, float* dest, int num) const noexcept;
+    void writeRun (int channel, int index, const float* source, int num) noexcept;
+
+    // One sample at a time, in whatever format - only for the odd copy that isn't a straight block
+    float getSample (int channel, int index) const noexcept;
+    void setSample (int channel, int index, float value) noexcept;
+
+    const int numChannels, length, guardLength;
+    const bool keepsHistory;
+    const SampleFormat format;
+    int channelStride = 0; // In samples
+
+    juce::HeapBlock<char> storage;
+    juce::HeapBlock<char*> channels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLine)
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+
+//==============================================================================
+/*
+    Carries the audio callback's levels to the message thread, for drawing.
+
+    The audio thread pushes one Block per callback - the peak going into the delay
+    line and the peak coming out - onto a lock-free SPSC fifo. Nothing on that side
+    locks, allocates or waits, and if the message thread falls behind the newest
+    blocks are dropped rather than anything being overwritten.
+
+    The message thread drains the fifo into a history of fixed-size bins covering
+    the longest delay, so anything can ask how loud the input was some number of
+    samples ago - which, for a tap, is how loud it is now.
+*/
+class LevelFifo
+{
+public:
+    struct Block
+    {
+        float inputPeak;    // Going into the delay line, across every channel
+        float outputPeak;   // Coming out of the callback
+        int numSamples;
+    };
+
+    LevelFifo() = default;
+
+    //==============================================================================
+    /** Audio thread: hands over one callback's levels. */
+    void push (const Block& block) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 > 0)
+            blocks[(size_t) start1] = block;
+
+        fifo.finishedWrite (size1);
+    }
+
+    //==============================================================================
+    /** Message thread: moves everything pushed since the last call into the history.
+        Returns how many samples' worth of blocks arrived.
+    */
+    int update() noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+
+        int numSamples = 0;
+
+        for (int i = 0; i < size1; ++i)
+            numSamples += addToHistory (blocks[(size_t) (start1 + i)]);
+
+        for (int i = 0; i < size2; ++i)
+            numSamples += addToHistory (blocks[(size_t) (start2 + i)]);
+
+        fifo.finishedRead (size1 + size2);
+        return numSamples;
+    }
+
+    /** Message thread: the loudest input or output between samplesAgo and samplesAgo + numSamples before the latest block ended. */
+    float getInputPeak (int samplesAgo, int numSamples) const noexcept     { return getPeak (inputBins, samplesAgo, numSamples); }
+    float getOutputPeak (int samplesAgo, int numSamples) const noexcept    { return getPeak (outputBins, samplesAgo, numSamples); }
+
+    /** Message thread: forgets everything, e.g. when the device restarts. */
+    void clearHistory() noexcept
+    {
+        inputBins.fill (0.0f);
+        outputBins.fill (0.0f);
+    }
+
+    /** Enough bins to reach back over the longest delay at up to 192kHz. */
+    static constexpr int samplesPerBin = 256;
+    static constexpr int numBins = 4096;
+
+private:
+    //==============================================================================
+    int addToHistory (const Block& block) noexcept
+    {
+        // A block can start part way into a bin, and bigger blocks span several
+        for (int done = 0; done < block.numSamples;)
+        {
+            if (samplesInBin == 0)
+            {
+                newestBin = (newestBin + 1) & (numBins - 1);
+                inputBins[(size_t) newestBin] = 0.0f;
+                outputBins[(size_t) newestBin] = 0.0f;
+            }
+
+            const int num = juce::jmin (block.numSamples - done, samplesPerBin - samplesInBin);
+
+            inputBins[(size_t) newestBin] = juce::jmax (inputBins[(size_t) newestBin], block.inputPeak);
+            outputBins[(size_t) newestBin] = juce::jmax (outputBins[(size_t) newestBin], block.outputPeak);
+
+            samplesInBin = (samplesInBin + num) % samplesPerBin;
+            done += num;
+        }
+
+        return block.numSamples;
+    }
+
+    float getPeak (const std::array<float, numBins>& bins, int samplesAgo, int numSamples) const noexcept
+    {
+        // The newest bin is usually only part full, which shifts where every older sample falls
+        const int samplesInNewestBin = samplesInBin > 0 ? samplesInBin : samplesPerBin;
+        auto getBinAgo = [=] (int ago) { return (ago + samplesPerBin - samplesInNewestBin) / samplesPerBin; };
+
+        const int firstBin = juce::jlimit (0, numBins - 1, getBinAgo (juce::jmax (0, samplesAgo)));
+        const int lastBin = juce::jlimit (firstBin, numBins - 1, getBinAgo (juce::jmax (0, samplesAgo) + juce::jmax (0, numSamples - 1)));
+
+        float peak = 0.0f;
+
+        for (int ago = firstBin; ago <= lastBin; ++ago)
+            peak = juce::jmax (peak, bins[(size_t) ((newestBin - ago) & (numBins - 1))]);
+
+        return peak;
+    }
+
+    // A third of a second of 32-sample blocks at 192kHz - far longer than the message thread ever goes between updates
+    static constexpr int fifoSize = 2048;
+    juce::AbstractFifo fifo { fifoSize };
+    std::array<Block, fifoSize> blocks;
+
+    // Message thread only
+    std::array<float, numBins> inputBins {}, outputBins {};
+    int newestBin = 0, samplesInBin = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (LevelFifo)
+};
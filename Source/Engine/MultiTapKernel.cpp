@@ -0,0 +1,460 @@
+#include "MultiTapKernel.h"
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#if defined (__AVX__)
+ #include <immintrin.h> // Also has F16C and AVX2, when they're enabled
+ #define DRAWDELAY_SIMD_AVX 1
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define DRAWDELAY_SIMD_SSE 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+ #include <arm_neon.h>
+ #define DRAWDELAY_SIMD_NEON 1
+#endif
+
+namespace MultiTapKernel
+{
+namespace
+{
+    //==============================================================================
+    // The handful of vector operations the kernel needs, for whichever instruction set we're compiled for
+   #if DRAWDELAY_SIMD_AVX
+    struct Vector
+    {
+        using Type = __m256;
+        static constexpr int width = 8;
+
+        static Type load (const float* source) noexcept         { return _mm256_loadu_ps (source); }
+        static void store (float* dest, Type value) noexcept    { _mm256_storeu_ps (dest, value); }
+        static Type broadcast (float value) noexcept            { return _mm256_set1_ps (value); }
+        static void storeInts (int* dest, Type wholeValue) noexcept    { _mm256_storeu_si256 (reinterpret_cast<__m256i*> (dest), _mm256_cvttps_epi32 (wholeValue)); }
+
+        static Type add (Type a, Type b) noexcept               { return _mm256_add_ps (a, b); }
+        static Type subtract (Type a, Type b) noexcept          { return _mm256_sub_ps (a, b); }
+        static Type multiply (Type a, Type b) noexcept          { return _mm256_mul_ps (a, b); }
+        static Type min (Type a, Type b) noexcept               { return _mm256_min_ps (a, b); }
+        static Type max (Type a, Type b) noexcept               { return _mm256_max_ps (a, b); }
+        static Type floor (Type value) noexcept                 { return _mm256_floor_ps (value); }
+
+       #if defined (__AVX2__)
+        static Type load (const juce::int16* source) noexcept
+        {
+            return _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (source))));
+        }
+       #endif
+
+       #if defined (__F16C__)
+        static Type load (const CompactSamples::Half* source) noexcept
+        {
+            return _mm256_cvtph_ps (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (source)));
+        }
+       #endif
+
+        static Type multiplyAdd (Type accumulator, Type a, Type b) noexcept
+        {
+           #if defined (__FMA__)
+            return _mm256_fmadd_ps (a, b, accumulator);
+           #else
+            return _mm256_add_ps (accumulator, _mm256_mul_ps (a, b));
+           #endif
+        }
+    };
+   #elif DRAWDELAY_SIMD_SSE
+    struct Vector
+    {
+        using Type = __m128;
+        static constexpr int width = 4;
+
+        static Type load (const float* source) noexcept         { return _mm_loadu_ps (source); }
+        static void store (float* dest, Type value) noexcept    { _mm_storeu_ps (dest, value); }
+        static Type broadcast (float value) noexcept            { return _mm_set1_ps (value); }
+        static void storeInts (int* dest, Type wholeValue) noexcept    { _mm_storeu_si128 (reinterpret_cast<__m128i*> (dest), _mm_cvttps_epi32 (wholeValue)); }
+
+        static Type add (Type a, Type b) noexcept               { return _mm_add_ps (a, b); }
+        static Type subtract (Type a, Type b) noexcept          { return _mm_sub_ps (a, b); }
+        static Type multiply (Type a, Type b) noexcept          { return _mm_mul_ps (a, b); }
+        static Type min (Type a, Type b) noexcept               { return _mm_min_ps (a, b); }
+        static Type max (Type a, Type b) noexcept               { return _mm_max_ps (a, b); }
+
+        static Type floor (Type value) noexcept
+        {
+            // SSE2 only truncates, which is a step too high for negative fractions
+            auto truncated = _mm_cvtepi32_ps (_mm_cvttps_epi32 (value));
+            return _mm_sub_ps (truncated, _mm_and_ps (_mm_cmpgt_ps (truncated, value), _mm_set1_ps (1.0f)));
+        }
+
+        static Type load (const juce::int16* source) noexcept
+        {
+            // Sign-extend by putting each sample in the top half of a 32-bit lane and shifting it back down
+            auto samples = _mm_loadl_epi64 (reinterpret_cast<const __m128i*> (source));
+            return _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (samples, samples), 16));
+        }
+
+        static Type multiplyAdd (Type accumulator, Type a, Type b) noexcept   { return _mm_add_ps (accumulator, _mm_mul_ps (a, b)); }
+    };
+   #elif DRAWDELAY_SIMD_NEON
+    struct Vector
+    {
+        using Type = float32x4_t;
+        static constexpr int width = 4;
+
+        static Type load (const float* source) noexcept         { return vld1q_f32 (source); }
+        static void store (float* dest, Type value) noexcept    { vst1q_f32 (dest, value); }
+        static Type broadcast (float value) noexcept            { return vdupq_n_f32 (value); }
+        static void storeInts (int* dest, Type wholeValue) noexcept    { vst1q_s32 (dest, vcvtq_s32_f32 (wholeValue)); }
+        static Type load (const juce::int16* source) noexcept   { return vcvtq_f32_s32 (vmovl_s16 (vld1_s16 (source))); }
+
+        static Type add (Type a, Type b) noexcept               { return vaddq_f32 (a, b); }
+        static Type subtract (Type a, Type b) noexcept          { return vsubq_f32 (a, b); }
+        static Type multiply (Type a, Type b) noexcept          { return vmulq_f32 (a, b); }
+        static Type min (Type a, Type b) noexcept               { return vminq_f32 (a, b); }
+        static Type max (Type a, Type b) noexcept               { return vmaxq_f32 (a, b); }
+
+        static Type floor (Type value) noexcept
+        {
+            // Converting truncates, which is a step too high for negative fractions
+            auto truncated = vcvtq_f32_s32 (vcvtq_s32_f32 (value));
+            auto tooHigh = vandq_u32 (vcgtq_f32 (truncated, value), vreinterpretq_u32_f32 (vdupq_n_f32 (1.0f)));
+            return vsubq_f32 (truncated, vreinterpretq_f32_u32 (tooHigh));
+        }
+
+       #if defined (__aarch64__)
+        static Type load (const CompactSamples::Half* source) noexcept
+        {
+            return vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (reinterpret_cast<const uint16_t*> (source))));
+        }
+       #endif
+
+        static Type multiplyAdd (Type accumulator, Type a, Type b) noexcept   { return vmlaq_f32 (accumulator, a, b); }
+    };
+   #else
+    struct Vector
+    {
+        using Type = float;
+        static constexpr int width = 1;
+
+        static Type load (const float* source) noexcept         { return *source; }
+        static void store (float* dest, Type value) noexcept    { *dest = value; }
+        static Type broadcast (float value) noexcept            { return value; }
+        static void storeInts (int* dest, Type wholeValue) noexcept    { *dest = (int) wholeValue; }
+
+        static Type add (Type a, Type b) noexcept               { return a + b; }
+        static Type subtract (Type a, Type b) noexcept          { return a - b; }
+        static Type multiply (Type a, Type b) noexcept          { return a * b; }
+        static Type min (Type a, Type b) noexcept               { return a < b ? a : b; }
+        static Type max (Type a, Type b) noexcept               { return a > b ? a : b; }
+        static Type floor (Type value) noexcept                 { return std::floor (value); }
+
+        static Type multiplyAdd (Type accumulator, Type a, Type b) noexcept   { return accumulator + a * b; }
+    };
+   #endif
+
+    //==============================================================================
+    // How each storage format is read. int16 samples are loaded as plain integers, with
+    // their scale folded into the tap gains so reading them costs nothing extra.
+    inline float toUnscaledFloat (float sample) noexcept                      { return sample; }
+    inline float toUnscaledFloat (juce::int16 sample) noexcept                { return (float) sample; }
+    inline float toUnscaledFloat (CompactSamples::Half sample) noexcept       { return CompactSamples::toFloat (sample); }
+
+    template <typename Sample> constexpr float gainScale = 1.0f;
+    template <> constexpr float gainScale<juce::int16> = CompactSamples::int16ToFloat;
+
+    // Uses the instruction set's own conversion where there is one...
+    template <typename Sample, typename V = Vector>
+    auto load (const Sample* source, int) noexcept -> decltype (V::load (source))
+    {
+        return V::load (source);
+    }
+
+    // ...otherwise converts a register's worth by hand
+    template <typename Sample, typename V = Vector>
+    typename V::Type load (const Sample* source, long) noexcept
+    {
+        float converted[V::width];
+
+        for (int i = 0; i < V::width; ++i)
+            converted[i] = toUnscaledFloat (source[i]);
+
+        return V::load (converted);
+    }
+
+    // Samples per chunk - 8 SSE/NEON registers or 4 AVX ones, so the accumulators never leave the CPU
+    constexpr int chunkSize = 32;
+    constexpr int numRegisters = chunkSize / Vector::width;
+
+    //==============================================================================
+    template <typename Sample>
+    void addTapsToChunk (float* output, const Sample* ring, int ringMask, int chunkOrigin,
+                         const int* delays, const float* gains, int numTaps) noexcept
+    {
+        Vector::Type accumulators[numRegisters];
+
+        for (int r = 0; r < numRegisters; ++r)
+            accumulators[r] = Vector::load (output + r * Vector::width);
+
+        for (int t = 0; t < numTaps; ++t)
+        {
+            const Sample* source = ring + ((chunkOrigin - delays[t]) & ringMask);
+            const auto gain = Vector::broadcast (gains[t] * gainScale<Sample>);
+
+            for (int r = 0; r < numRegisters; ++r)
+                accumulators[r] = Vector::multiplyAdd (accumulators[r], load (source + r * Vector::width, 0), gain);
+        }
+
+        for (int r = 0; r < numRegisters; ++r)
+            Vector::store (output + r * Vector::width, accumulators[r]);
+    }
+
+    // Whatever is left over at the end of a block that doesn't fill a whole chunk
+    template <typename Sample>
+    void addTapsToTail (float* output, int numSamples, const Sample* ring, int ringMask, int chunkOrigin,
+                        const int* delays, const float* gains, int numTaps) noexcept
+    {
+        for (int t = 0; t < numTaps; ++t)
+        {
+            const Sample* source = ring + ((chunkOrigin - delays[t]) & ringMask);
+            const float gain = gains[t] * gainScale<Sample>;
+
+            for (int i = 0; i < numSamples; ++i)
+                output[i] += toUnscaledFloat (source[i]) * gain;
+        }
+    }
+
+    template <typename Sample>
+    void addTapsFrom (float* output, int numSamples,
+                      const Sample* ring, int ringMask, int readOrigin,
+                      const int* delays, const float* gains, int numTaps) noexcept
+    {
+        jassert (juce::isPowerOfTwo (ringMask + 1));
+
+        if (numTaps <= 0)
+            return;
+
+        int start = 0;
+
+        for (; start + chunkSize <= numSamples; start += chunkSize)
+            addTapsToChunk (output + start, ring, ringMask, readOrigin + start, delays, gains, numTaps);
+
+        if (start < numSamples)
+            addTapsToTail (output + start, numSamples - start, ring, ringMask, readOrigin + start, delays, gains, numTaps);
+    }
+
+    //==============================================================================
+    // The per-tap constants of a group of modulated taps. Delays are kept relative to a whole number
+    // of samples near the start, so the floats only ever hold small numbers and keep their fractions.
+    constexpr int modulatedGroupSize = 32;
+
+    struct ModulatedGroup
+    {
+        int numTaps = 0;
+        int baseDelay[modulatedGroupSize];
+        float startDelay[modulatedGroupSize], delayChange[modulatedGroupSize];
+        float lowestDelay[modulatedGroupSize], highestDelay[modulatedGroupSize];
+        float startGain[modulatedGroupSize], gainChange[modulatedGroupSize];
+
+        ModulatedGroup (const ModulatedTaps& taps, int first, float minimumDelay, float maximumDelay, float gainScale) noexcept
+        {
+            numTaps = juce::jmin (modulatedGroupSize, taps.numTaps - first);
+
+            for (int t = 0; t < numTaps; ++t)
+            {
+                const auto start = taps.startDelays[first + t];
+                baseDelay[t] = (int) std::floor (start);
+
+                startDelay[t] = (float) (start - baseDelay[t]);
+                delayChange[t] = (float) (taps.endDelays[first + t] - start);
+                lowestDelay[t] = minimumDelay - (float) baseDelay[t];
+                highestDelay[t] = maximumDelay - (float) baseDelay[t];
+                startGain[t] = taps.startGains[first + t] * gainScale;
+                gainChange[t] = taps.endGains[first + t] * gainScale - startGain[t];
+            }
+        }
+    };
+
+    // Reads one tap at one sample, given its delay split into whole samples and a fraction
+    template <typename Sample>
+    float readBetween (const Sample* ring, int ringMask, int position, int wholeDelay, float fraction, bool cubic) noexcept
+    {
+        // Always read forwards from the oldest sample needed - the guard region means that never wraps
+        if (cubic)
+        {
+            const Sample* source = ring + ((position - wholeDelay - 2) & ringMask);
+            const float x2 = toUnscaledFloat (source[0]), x1 = toUnscaledFloat (source[1]);
+            const float x0 = toUnscaledFloat (source[2]), xm1 = toUnscaledFloat (source[3]);
+
+            const float f = fraction, a = f * (f - 1.0f), b = (f + 1.0f) * (f - 2.0f);
+            return xm1 * (-a * (f - 2.0f) * (1.0f / 6.0f)) + x0 * (b * (f - 1.0f) * 0.5f)
+                 + x1 * (-b * f * 0.5f) + x2 * (a * (f + 1.0f) * (1.0f / 6.0f));
+        }
+
+        const Sample* source = ring + ((position - wholeDelay - 1) & ringMask);
+        const float x1 = toUnscaledFloat (source[0]), x0 = toUnscaledFloat (source[1]);
+        return x0 + fraction * (x1 - x0);
+    }
+
+    template <typename Sample>
+    void addModulatedGroup (float* output, int numSamples, const Sample* ring, int ringMask, int readOrigin,
+                            const ModulatedGroup& group, const float* glide, const float* offsets, bool cubic) noexcept
+    {
+        using V = Vector;
+        constexpr int width = V::width;
+        int i = 0;
+
+        for (; i + width <= numSamples; i += width)
+        {
+            const auto glideNow = V::load (glide + i), offsetNow = V::load (offsets + i);
+            auto accumulator = V::load (output + i);
+
+            for (int t = 0; t < group.numTaps; ++t)
+            {
+                // Every lane's delay and gain at once...
+                auto delay = V::multiplyAdd (V::add (V::broadcast (group.startDelay[t]), offsetNow), glideNow, V::broadcast (group.delayChange[t]));
+                delay = V::min (V::broadcast (group.highestDelay[t]), V::max (V::broadcast (group.lowestDelay[t]), delay));
+
+                const auto whole = V::floor (delay);
+                const auto fraction = V::subtract (delay, whole);
+                const auto gain = V::multiplyAdd (V::broadcast (group.startGain[t]), glideNow, V::broadcast (group.gainChange[t]));
+
+                alignas (32) int wholeDelays[width];
+                V::storeInts (wholeDelays, whole);
+
+                // ...then the reads, which can be anywhere in the ring...
+                alignas (32) float x2[width], x1[width], x0[width], xm1[width];
+
+                for (int lane = 0; lane < width; ++lane)
+                {
+                    const int wholeDelay = group.baseDelay[t] + wholeDelays[lane];
+
+                    if (cubic)
+                    {
+                        const Sample* source = ring + ((readOrigin + i + lane - wholeDelay - 2) & ringMask);
+                        x2[lane] = toUnscaledFloat (source[0]);
+                        x1[lane] = toUnscaledFloat (source[1]);
+                        x0[lane] = toUnscaledFloat (source[2]);
+                        xm1[lane] = toUnscaledFloat (source[3]);
+                    }
+                    else
+                    {
+                        const Sample* source = ring + ((readOrigin + i + lane - wholeDelay - 1) & ringMask);
+                        x1[lane] = toUnscaledFloat (source[0]);
+                        x0[lane] = toUnscaledFloat (source[1]);
+                    }
+                }
+
+                // ...and the interpolation back in registers
+                V::Type value;
+                const auto vx0 = V::load (x0), vx1 = V::load (x1);
+
+                if (cubic)
+                {
+                    const auto one = V::broadcast (1.0f), two = V::broadcast (2.0f);
+                    const auto fMinus1 = V::subtract (fraction, one), fMinus2 = V::subtract (fraction, two), fPlus1 = V::add (fraction, one);
+                    const auto a = V::multiply (fraction, fMinus1), b = V::multiply (fPlus1, fMinus2);
+
+                    value = V::multiply (V::load (xm1), V::multiply (V::multiply (a, fMinus2), V::broadcast (-1.0f / 6.0f)));
+                    value = V::multiplyAdd (value, vx0, V::multiply (V::multiply (b, fMinus1), V::broadcast (0.5f)));
+                    value = V::multiplyAdd (value, vx1, V::multiply (V::multiply (b, fraction), V::broadcast (-0.5f)));
+                    value = V::multiplyAdd (value, V::load (x2), V::multiply (V::multiply (a, fPlus1), V::broadcast (1.0f / 6.0f)));
+                }
+                else
+                {
+                    value = V::multiplyAdd (vx0, fraction, V::subtract (vx1, vx0));
+                }
+
+                accumulator = V::multiplyAdd (accumulator, value, gain);
+            }
+
+            V::store (output + i, accumulator);
+        }
+
+        // Whatever doesn't fill a whole register
+        for (; i < numSamples; ++i)
+        {
+            for (int t = 0; t < group.numTaps; ++t)
+            {
+                const float delay = juce::jlimit (group.lowestDelay[t], group.highestDelay[t],
+                                                  group.startDelay[t] + offsets[i] + glide[i] * group.delayChange[t]);
+                const float whole = std::floor (delay);
+
+                output[i] += readBetween (ring, ringMask, readOrigin + i, group.baseDelay[t] + (int) whole, delay - whole, cubic)
+                               * (group.startGain[t] + glide[i] * group.gainChange[t]);
+            }
+        }
+    }
+
+    template <typename Sample>
+    void addModulatedTapsFrom (float* output, int numSamples, const Sample* ring, int ringMask, int readOrigin,
+                               const ModulatedTaps& taps, const float* glide, const float* offsets,
+                               int maximumDelay, Interpolation interpolation) noexcept
+    {
+        jassert (juce::isPowerOfTwo (ringMask + 1));
+
+        // Cubic reads a sample newer than the delay, which has to have been written already
+        const bool cubic = interpolation == Interpolation::cubic;
+        const float minimumDelay = cubic ? 1.0f : 0.0f;
+        const float highestDelay = (float) juce::jmax (2, maximumDelay - 2);
+
+        for (int first = 0; first < taps.numTaps; first += modulatedGroupSize)
+        {
+            const ModulatedGroup group (taps, first, minimumDelay, highestDelay, gainScale<Sample>);
+            addModulatedGroup (output, numSamples, ring, ringMask, readOrigin, group, glide, offsets, cubic);
+        }
+    }
+}
+//==============================================================================
+void addTaps (float* output, int numSamples,
+              const float* ring, int ringMask, int readOrigin,
+              const int* delays, const float* gains, int numTaps) noexcept
+{
+    addTapsFrom (output, numSamples, ring, ringMask, readOrigin, delays, gains, numTaps);
+}
+
+void addTaps (float* output, int numSamples,
+              const CompactSamples::Half* ring, int ringMask, int readOrigin,
+              const int* delays, const float* gains, int numTaps) noexcept
+{
+    addTapsFrom (output, numSamples, ring, ringMask, readOrigin, delays, gains, numTaps);
+}
+
+void addTaps (float* output, int numSamples,
+              const juce::int16* ring, int ringMask, int readOrigin,
+              const int* delays, const float* gains, int numTaps) noexcept
+{
+    addTapsFrom (output, numSamples, ring, ringMask, readOrigin, delays, gains, numTaps);
+}
+
+const char* getInstructionSetName() noexcept
+{
+   #if DRAWDELAY_SIMD_AVX
+    return "AVX";
+   #elif DRAWDELAY_SIMD_SSE
+    return "SSE2";
+   #elif DRAWDELAY_SIMD_NEON
+    return "NEON";
+   #else
+    return "scalar";
+   #endif
+}
+
+//==============================================================================
+void addModulatedTaps (float* output, int numSamples, const float* ring, int ringMask, int readOrigin,
+                       const ModulatedTaps& taps, const float* glide, const float* offsets,
+                       int maximumDelay, Interpolation interpolation) noexcept
+{
+    addModulatedTapsFrom (output, numSamples, ring, ringMask, readOrigin, taps, glide, offsets, maximumDelay, interpolation);
+}
+
+void addModulatedTaps (float* output, int numSamples, const CompactSamples::Half* ring, int ringMask, int readOrigin,
+                       const ModulatedTaps& taps, const float* glide, const float* offsets,
+                       int maximumDelay, Interpolation interpolation) noexcept
+{
+    addModulatedTapsFrom (output, numSamples, ring, ringMask, readOrigin, taps, glide, offsets, maximumDelay, interpolation);
+}
+
+void addModulatedTaps (float* output, int numSamples, const juce::int16* ring, int ringMask, int readOrigin,
+                       const ModulatedTaps& taps, const float* glide, const float* offsets,
+                       int maximumDelay, Interpolation interpolation) noexcept
+{
+    addModulatedTapsFrom (output, numSamples, ring, ringMask, readOrigin, taps, glide, offsets, maximumDelay, interpolation);
+}
+}
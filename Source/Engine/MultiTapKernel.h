@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CompactSamples.h"
+
+//==============================================================================
+/*
+    The multi-tap read used by getFromDelayBuffer.
+
+    Instead of walking the whole output block once per tap, the block is split into
+    small chunks whose accumulators live in SIMD registers (SSE/AVX on Intel, NEON on
+    ARM, plain floats otherwise). Every tap is added into a chunk before moving on, so
+    the output is only loaded and stored once however many taps there are.
+
+    Reads never wrap - see DelayLine - so there's no per-tap branching at all.
+
+    There's a version for each DelayLine sample format; the 16-bit ones convert as
+    they load, which is still cheaper than the extra memory traffic of floats once
+    the line is bigger than the cache.
+*/
+namespace MultiTapKernel
+{
+    /** Adds every tap into output[0..numSamples).
+
+        Sample i of tap t is read from ring[((readOrigin - delays[t]) & ringMask) + i] and
+        scaled by gains[t]. The ring is a DelayLine, whose guard region mirrors its start,
+        so every tap is one straight run however close to the end of the ring it starts.
+
+        numSamples must be no more than the ring's guard length and every delay no more
+        than ringMask + 1.
+    */
+    void addTaps (float* output, int numSamples,
+                  const float* ring, int ringMask, int readOrigin,
+                  const int* delays, const float* gains, int numTaps) noexcept;
+
+    void addTaps (float* output, int numSamples,
+                  const CompactSamples::Half* ring, int ringMask, int readOrigin,
+                  const int* delays, const float* gains, int numTaps) noexcept;
+
+    void addTaps (float* output, int numSamples,
+                  const juce::int16* ring, int ringMask, int readOrigin,
+                  const int* delays, const float* gains, int numTaps) noexcept;
+
+    /** The instruction set the kernels were compiled for: "AVX", "SSE2", "NEON" or "scalar". */
+    const char* getInstructionSetName() noexcept;
+
+    //==============================================================================
+    /** How a tap that falls between two samples is read. */
+    enum class Interpolation
+    {
+        none,       // Rounded to the nearest sample - taps that are moving still get linear
+        linear,
+        cubic       // Third-order Lagrange, over the two samples either side
+    };
+
+    /** Taps for addModulatedTaps(), in any order. Each one's delay (in samples) and gain glide
+        from start to end as the glide ramp goes from 0 to 1.
+    */
+    struct ModulatedTaps
+    {
+        const double* startDelays;
+        const double* endDelays;
+        const float* startGains;
+        const float* endGains;
+        int numTaps;
+    };
+
+    /** Adds taps whose delays change from one sample to the next, e.g. while a tap is being
+        dragged or an LFO is wobbling them.
+
+        Tap t's delay at sample i is startDelays[t] + (endDelays[t] - startDelays[t]) * glide[i] + offsets[i],
+        kept between 0 (1 for cubic) and maximumDelay - 2, and its gain glides the same way. The delays
+        and interpolation are worked out a register at a time; only the reads themselves are scalar,
+        as each lane's taps can be anywhere in the ring.
+
+        Costs several times as much per tap as addTaps(), so only use it for taps that are actually moving.
+    */
+    void addModulatedTaps (float* output, int numSamples, const float* ring, int ringMask, int readOrigin,
+                           const ModulatedTaps& taps, const float* glide, const float* offsets,
+                           int maximumDelay, Interpolation interpolation) noexcept;
+
+    void addModulatedTaps (float* output, int numSamples, const CompactSamples::Half* ring, int ringMask, int readOrigin,
+                           const ModulatedTaps& taps, const float* glide, const float* offsets,
+                           int maximumDelay, Interpolation interpolation) noexcept;
+
+    void addModulatedTaps (float* output, int numSamples, const juce::int16* ring, int ringMask, int readOrigin,
+                           const ModulatedTaps& taps, const float* glide, const float* offsets,
+                           int maximumDelay, Interpolation interpolation) noexcept;
+}
@@ -0,0 +1,294 @@
+#include "PartitionedConvolver.h"
+
+namespace
+{
+    // Stage sizes: the first partition is also the shortest tap that can be convolved,
+    // and 8192 keeps the biggest FFT's scratch space on the stack
+    constexpr int firstPartitionSize = 256;
+    constexpr int maximumPartitionSize = 8192;
+    constexpr int stageGrowth = 8;
+}
+
+//==============================================================================
+std::vector<PartitionedConvolver::Stage> PartitionedConvolver::createLayout (int maximumDelaySamples)
+{
+    std::vector<Stage> layout;
+
+    int partitionSize = firstPartitionSize;
+    int firstDelay = partitionSize;
+
+    while (firstDelay <= maximumDelaySamples)
+    {
+        const bool lastStage = partitionSize == maximumPartitionSize || firstDelay * stageGrowth > maximumDelaySamples;
+        const int endDelay = lastStage ? maximumDelaySamples + 1 : firstDelay * stageGrowth;
+
+        // The response is shifted forward by one partition, so it reaches endDelay - partitionSize
+        const int numPartitions = (endDelay - 1 - partitionSize) / partitionSize + 1;
+
+        layout.push_back ({ partitionSize, firstDelay, endDelay, numPartitions });
+
+        firstDelay = endDelay;
+        partitionSize = juce::jmin (partitionSize * stageGrowth, maximumPartitionSize);
+    }
+
+    return layout;
+}
+
+int PartitionedConvolver::getFFTOrder (int partitionSize) noexcept
+{
+    // Each FFT covers two partitions
+    int order = 1;
+
+    while ((1 << order) < partitionSize * 2)
+        ++order;
+
+    return order;
+}
+
+std::unique_ptr<PartitionedConvolver::Filter> PartitionedConvolver::createFilter (const std::vector<Stage>& layout, const int* delays,
+                                                                                  const float* gains, const int* stageTapStart)
+{
+    auto filter = std::make_unique<Filter>();
+    filter->stages.resize (layout.size());
+
+    bool anyStageUsed = false;
+
+    for (size_t s = 0; s < layout.size(); ++s)
+    {
+        const auto& stage = layout[s];
+        const int partitionSize = stage.partitionSize;
+        const int begin = stageTapStart[s];
+        const int end = stageTapStart[s + 1];
+
+        if (end <= begin)
+            continue;
+
+        // Taps are sorted, so counting the partitions that hold any is one pass
+        int numUsedPartitions = 0;
+
+        for (int t = begin, lastPartition = -1; t < end; ++t)
+        {
+            const int partition = (delays[t] - partitionSize) / partitionSize;
+
+            if (partition != lastPartition)
+            {
+                ++numUsedPartitions;
+                lastPartition = partition;
+            }
+        }
+
+        // Rough flops per output sample: two per tap directly, against a complex multiply-add
+        // per bin for each used partition plus a forward and an inverse FFT per partition
+        const double directCost = 2.0 * (end - begin);
+        const double convolutionCost = 8.0 * numUsedPartitions * (partitionSize + 1) / partitionSize
+                                        + 10.0 * std::log2 (2.0 * partitionSize);
+
+        if (convolutionCost >= directCost)
+            continue;
+
+        juce::dsp::FFT fft (getFFTOrder (partitionSize));
+        std::vector<float> work ((size_t) (partitionSize * 4));
+
+        for (int t = begin; t < end;)
+        {
+            const int partition = (delays[t] - partitionSize) / partitionSize;
+            std::fill (work.begin(), work.end(), 0.0f);
+
+            // Every tap in this partition becomes one coefficient of the shifted response
+            for (; t < end && (delays[t] - partitionSize) / partitionSize == partition; ++t)
+                work[(size_t) (delays[t] - partitionSize - partition * partitionSize)] += gains[t];
+
+            fft.performRealOnlyForwardTransform (work.data(), true);
+
+            filter->stages[s].push_back ({ partition, std::vector<float> (work.begin(), work.begin() + (partitionSize + 1) * 2) });
+        }
+
+        anyStageUsed = true;
+    }
+
+    if (! anyStageUsed)
+        return {};
+
+    return filter;
+}
+
+//==============================================================================
+void PartitionedConvolver::prepare (const std::vector<Stage>& layout, int numChannels)
+{
+    stages.clear();
+    stages.resize (layout.size());
+
+    for (size_t s = 0; s < layout.size(); ++s)
+    {
+        auto& stage = stages[s];
+        const int partitionSize = layout[s].partitionSize;
+
+        stage.layout = layout[s];
+        stage.channels.resize ((size_t) numChannels);
+
+        for (auto& channel : stage.channels)
+        {
+            channel.input.assign ((size_t) (partitionSize * 2), 0.0f);
+            channel.spectra.assign ((size_t) (layout[s].numPartitions * (partitionSize + 1) * 2), 0.0f);
+            channel.output.assign ((size_t) partitionSize, 0.0f);
+            channel.work.assign ((size_t) (partitionSize * 4), 0.0f);
+            channel.fft = std::make_unique<juce::dsp::FFT> (getFFTOrder (partitionSize));
+        }
+    }
+
+    currentFilter = nullptr;
+}
+
+void PartitionedConvolver::reset()
+{
+    for (auto& stage : stages)
+    {
+        stage.active = stage.ready = false;
+
+        for (auto& channel : stage.channels)
+        {
+            std::fill (channel.input.begin(), channel.input.end(), 0.0f);
+            std::fill (channel.output.begin(), channel.output.end(), 0.0f);
+            channel.fill = channel.newestSlot = channel.partitionsSeen = 0;
+            channel.recompute = false;
+        }
+    }
+}
+
+//==============================================================================
+void PartitionedConvolver::beginBlock (const Filter* filter, bool filterChanged) noexcept
+{
+    currentFilter = filter;
+
+    for (size_t s = 0; s < stages.size(); ++s)
+    {
+        auto& stage = stages[s];
+
+        if (filter == nullptr || ! filter->usesStage ((int) s))
+        {
+            // Stop feeding the stage - it'll have to fill its delay line again if it's needed later
+            if (stage.active)
+                for (auto& channel : stage.channels)
+                    channel.fill = channel.partitionsSeen = 0;
+
+            stage.active = stage.ready = false;
+            continue;
+        }
+
+        stage.active = true;
+
+        if (stage.channels.empty())
+            continue;
+
+        // Ready once the whole frequency-domain delay line holds real input and an output partition has been made from it
+        stage.ready = stage.channels.front().partitionsSeen >= stage.layout.numPartitions + 2;
+
+        if (filterChanged && stage.ready)
+            for (auto& channel : stage.channels)
+                channel.recompute = true;
+    }
+}
+
+void PartitionedConvolver::process (int channelIndex, const float* input, float* output, int numSamples) noexcept
+{
+    for (size_t s = 0; s < stages.size(); ++s)
+    {
+        auto& stage = stages[s];
+
+        if (! stage.active)
+            continue;
+
+        auto& channel = stage.channels[(size_t) channelIndex];
+        const int partitionSize = stage.layout.partitionSize;
+
+        if (channel.recompute)
+        {
+            computeOutput (stage, channel, (int) s);
+            channel.recompute = false;
+        }
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int num = juce::jmin (numSamples - done, partitionSize - channel.fill);
+
+            // Take the input before adding any output, in case they're the same samples
+            std::copy (input + done, input + done + num, channel.input.begin() + partitionSize + channel.fill);
+
+            if (stage.ready)
+                juce::FloatVectorOperations::add (output + done, channel.output.data() + channel.fill, num);
+
+            channel.fill += num;
+            done += num;
+
+            if (channel.fill == partitionSize)
+                takePartition (stage, channel, (int) s);
+        }
+    }
+}
+
+//==============================================================================
+void PartitionedConvolver::takePartition (StageState& stage, ChannelState& channel, int stageIndex) noexcept
+{
+    const int partitionSize = stage.layout.partitionSize;
+    const int numPartitions = stage.layout.numPartitions;
+    const int spectrumSize = (partitionSize + 1) * 2;
+
+    // Transform the last two partitions of input into the next slot of the frequency-domain delay line
+    std::copy (channel.input.begin(), channel.input.end(), channel.work.begin());
+    std::fill (channel.work.begin() + partitionSize * 2, channel.work.end(), 0.0f);
+    channel.fft->performRealOnlyForwardTransform (channel.work.data(), true);
+
+    channel.newestSlot = (channel.newestSlot + 1) % numPartitions;
+    std::copy (channel.work.begin(), channel.work.begin() + spectrumSize, channel.spectra.begin() + channel.newestSlot * spectrumSize);
+
+    // Slide the input along by a partition
+    std::copy (channel.input.begin() + partitionSize, channel.input.end(), channel.input.begin());
+    channel.fill = 0;
+
+    if (channel.partitionsSeen < numPartitions + 2)
+        ++channel.partitionsSeen;
+
+    // Every slot that gets used now holds a full two partitions of real input
+    if (channel.partitionsSeen > numPartitions)
+        computeOutput (stage, channel, stageIndex);
+}
+
+void PartitionedConvolver::computeOutput (StageState& stage, ChannelState& channel, int stageIndex) noexcept
+{
+    if (currentFilter == nullptr)
+        return;
+
+    const int partitionSize = stage.layout.partitionSize;
+    const int numPartitions = stage.layout.numPartitions;
+    const int spectrumSize = (partitionSize + 1) * 2;
+    const int fftSize = partitionSize * 2;
+    float* accumulator = channel.work.data();
+
+    std::fill (channel.work.begin(), channel.work.end(), 0.0f);
+
+    // Multiply-add every partition that holds taps with the input spectrum from that many partitions ago
+    for (auto& partition : currentFilter->stages[(size_t) stageIndex])
+    {
+        const int slot = (channel.newestSlot - partition.index + numPartitions) % numPartitions;
+        const float* x = channel.spectra.data() + slot * spectrumSize;
+        const float* h = partition.spectrum.data();
+
+        for (int i = 0; i < spectrumSize; i += 2)
+        {
+            accumulator[i]     += x[i] * h[i]     - x[i + 1] * h[i + 1];
+            accumulator[i + 1] += x[i] * h[i + 1] + x[i + 1] * h[i];
+        }
+    }
+
+    // Fill in the negative frequencies so the inverse transform doesn't depend on the FFT backend doing it
+    for (int bin = 1; bin < partitionSize; ++bin)
+    {
+        accumulator[(fftSize - bin) * 2]     =  accumulator[bin * 2];
+        accumulator[(fftSize - bin) * 2 + 1] = -accumulator[bin * 2 + 1];
+    }
+
+    channel.fft->performRealOnlyInverseTransform (accumulator);
+
+    // Overlap-save: only the second half is free of wrap-around
+    std::copy (accumulator + partitionSize, accumulator + fftSize, channel.output.begin());
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <vector>
+
+//==============================================================================
+/*
+    FFT convolution for dense tap patterns.
+
+    The taps are one sparse impulse response, so past a few hundred taps it's cheaper
+    to convolve than to add every tap separately. The response is split into stages
+    of growing partition size (256, 2048 then 8192 samples). Each stage is a uniformly
+    partitioned overlap-save convolver that only covers taps at least one partition
+    long, with its part of the response shifted forward by that partition. Its
+    natural one-partition latency then lands exactly where the taps belong, so the
+    convolution adds no latency at all. Taps shorter than the first partition always
+    go through the direct kernel.
+
+    The partition spectra for a tap table are built on the message thread (see
+    createFilter()); the audio thread only runs forward FFTs of the input, the
+    spectral multiply-adds for the partitions that actually hold taps, and one
+    inverse FFT per partition.
+
+    A stage needs a full delay line's worth of input spectra before its output is
+    valid. Until then it reports !isStageReady() and the engine keeps those taps on
+    the direct path, so switching between the two is seamless.
+*/
+class PartitionedConvolver
+{
+public:
+    //==============================================================================
+    /** One uniformly partitioned section, covering taps in [firstDelay, endDelay). */
+    struct Stage
+    {
+        int partitionSize, firstDelay, endDelay, numPartitions;
+    };
+
+    static std::vector<Stage> createLayout (int maximumDelaySamples);
+
+    //==============================================================================
+    /** The partition spectra for one set of taps. Stages with no partitions are left to the direct path. */
+    struct Filter
+    {
+        struct Partition
+        {
+            int index;
+            std::vector<float> spectrum; // partitionSize + 1 complex bins, interleaved
+        };
+
+        std::vector<std::vector<Partition>> stages;
+
+        bool usesStage (int stage) const noexcept   { return ! stages[(size_t) stage].empty(); }
+    };
+
+    /** Builds the spectra for taps sorted by delay, where stageTapStart[s] is the first tap in stage s.
+        Each stage only gets convolved if that's estimated to be cheaper than adding its taps directly;
+        returns nullptr if no stage is worth it.
+    */
+    static std::unique_ptr<Filter> createFilter (const std::vector<Stage>& layout, const int* delays, const float* gains,
+                                                 const int* stageTapStart);
+
+    //==============================================================================
+    PartitionedConvolver() = default;
+
+    void prepare (const std::vector<Stage>& layout, int numChannels);
+    void reset();
+
+    /** Audio thread: call once per block before process(), with the filter for this block (or nullptr).
+        filterChanged must be true whenever the filter is a different one from last block's.
+    */
+    void beginBlock (const Filter* filter, bool filterChanged) noexcept;
+
+    /** True if this stage's taps are being convolved this block, so the direct path should skip them. */
+    bool isStageReady (int stage) const noexcept    { return stages[(size_t) stage].ready; }
+
+    /** Feeds numSamples of one channel's input in and adds the convolved output to output.
+        Every channel must be given the same number of samples, in as many calls as you like.
+        Different channels can be processed on different threads at the same time.
+    */
+    void process (int channel, const float* input, float* output, int numSamples) noexcept;
+
+    int getNumStages() const noexcept    { return (int) stages.size(); }
+
+private:
+    //==============================================================================
+    struct ChannelState
+    {
+        std::vector<float> input;   // The last two partitions of input
+        std::vector<float> spectra; // Frequency-domain delay line: numPartitions input spectra
+        std::vector<float> output;  // This partition's worth of output
+        std::vector<float> work;    // FFT scratch
+
+        // Each channel has its own FFT so channels processed on different threads never share an engine
+        std::unique_ptr<juce::dsp::FFT> fft;
+
+        // Every channel sees the same samples, so these move in lockstep
+        int fill = 0;               // How far into the current partition we are
+        int newestSlot = 0;         // Where the most recent input spectrum went
+        int partitionsSeen = 0;     // Partitions taken since the stage became active (stops counting once it's ready)
+        bool recompute = false;     // The filter changed, so redo this partition's output before using it
+    };
+
+    struct StageState
+    {
+        Stage layout;
+        std::vector<ChannelState> channels;
+        bool active = false, ready = false;
+    };
+
+    void takePartition (StageState&, ChannelState&, int stageIndex) noexcept;
+    void computeOutput (StageState&, ChannelState&, int stageIndex) noexcept;
+
+    static int getFFTOrder (int partitionSize) noexcept;
+
+    std::vector<StageState> stages;
+    const Filter* currentFilter = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PartitionedConvolver)
+};
@@ -0,0 +1,431 @@
+#include "RealtimeSafety.h"
+
+#if DRAWDELAY_REALTIME_CHECKS
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX && defined (__GLIBC__)
+ #define DRAWDELAY_INTERPOSE_LIBC 1
+ #include <cerrno>
+ #include <cstdarg>
+ #include <ctime>
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <unistd.h>
+#else
+ #define DRAWDELAY_INTERPOSE_LIBC 0
+#endif
+
+// Keeps the thread-locals from being allocated lazily, which would mean calling malloc from inside malloc
+#if defined (__GNUC__)
+ #define DRAWDELAY_STATIC_TLS __attribute__ ((tls_model ("initial-exec")))
+#else
+ #define DRAWDELAY_STATIC_TLS
+#endif
+
+namespace RealtimeSafety
+{
+namespace
+{
+    thread_local int checkDepth DRAWDELAY_STATIC_TLS = 0;
+    thread_local int allowance DRAWDELAY_STATIC_TLS = 0;
+    thread_local bool isReporting DRAWDELAY_STATIC_TLS = false; // Reporting allocates and writes, so nothing is trapped meanwhile
+
+    std::atomic<int> violationCounts[numViolationTypes] {};
+    std::atomic<int> numReported { 0 };
+    std::atomic<bool> failFast { std::getenv ("DRAWDELAY_REALTIME_FAIL_FAST") != nullptr };
+
+    // After this many, violations are only counted, so one on every block doesn't bury the log
+    constexpr int maximumReports = 16;
+
+    int getIndex (Violation type) noexcept
+    {
+        switch (type)
+        {
+            case allocation:     return 0;
+            case deallocation:   return 1;
+            case lock:           return 2;
+            case blockingCall:
+            default:             return 3;
+        }
+    }
+
+    const char* getName (Violation type) noexcept
+    {
+        switch (type)
+        {
+            case allocation:     return "allocation";
+            case deallocation:   return "deallocation";
+            case lock:           return "lock";
+            case blockingCall:
+            default:             return "blocking call";
+        }
+    }
+
+    void report (Violation type, const char* function) noexcept
+    {
+        const juce::ScopedValueSetter<bool> reporting (isReporting, true);
+
+        ++violationCounts[getIndex (type)];
+
+        if (numReported++ < maximumReports)
+        {
+            auto message = juce::String ("Realtime-safety violation: ") + getName (type) + " in " + function
+                         + " inside a realtime check\n" + juce::SystemStats::getStackBacktrace() + "\n";
+
+            std::fputs (message.toRawUTF8(), stderr);
+            std::fflush (stderr);
+        }
+
+        if (failFast.load())
+            std::abort();
+    }
+
+    // Called from inside every interposed function, so it only reads thread-locals until it finds something
+    inline void check (Violation type, const char* function) noexcept
+    {
+        if (checkDepth > 0 && (allowance & type) == 0 && ! isReporting)
+            report (type, function);
+    }
+}
+
+//==============================================================================
+ScopedRealtimeCheck::ScopedRealtimeCheck (bool shouldCheck) noexcept
+    : isActive (shouldCheck), previousAllowance (allowance)
+{
+    // An allowance made outside doesn't carry into a new check
+    if (isActive)
+    {
+        ++checkDepth;
+        allowance = 0;
+    }
+}
+
+ScopedRealtimeCheck::~ScopedRealtimeCheck() noexcept
+{
+    if (isActive)
+    {
+        --checkDepth;
+        allowance = previousAllowance;
+    }
+}
+
+bool isCheckingThisThread() noexcept    { return checkDepth > 0; }
+
+ScopedAllowance::ScopedAllowance (int violationsToAllow) noexcept
+    : previousAllowance (allowance)
+{
+    allowance |= violationsToAllow;
+}
+
+ScopedAllowance::~ScopedAllowance() noexcept
+{
+    allowance = previousAllowance;
+}
+
+//==============================================================================
+int getNumViolations() noexcept
+{
+    int total = 0;
+
+    for (auto& count : violationCounts)
+        total += count.load();
+
+    return total;
+}
+
+int getNumViolations (Violation type) noexcept    { return violationCounts[getIndex (type)].load(); }
+
+void resetViolations() noexcept
+{
+    for (auto& count : violationCounts)
+        count = 0;
+
+    numReported = 0;
+}
+
+void setFailFast (bool shouldAbort) noexcept    { failFast = shouldAbort; }
+}
+
+//==============================================================================
+#if DRAWDELAY_INTERPOSE_LIBC
+
+using RealtimeSafety::check;
+
+namespace
+{
+    // The real function, found the first time it's needed. The cache is constant-initialised,
+    // so there's no guard variable (which could lock) in the way.
+    template <typename Function>
+    Function* findNext (std::atomic<void*>& cache, const char* name) noexcept
+    {
+        auto* address = cache.load (std::memory_order_relaxed);
+
+        if (address == nullptr)
+        {
+            address = dlsym (RTLD_NEXT, name);
+            cache.store (address, std::memory_order_relaxed);
+        }
+
+        return reinterpret_cast<Function*> (address);
+    }
+}
+
+// Definitions in the executable take the place of the C library's for every caller, JUCE
+// and the standard library included. The allocator's own entry points need no lookup.
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+
+    //==============================================================================
+    void* malloc (size_t size) noexcept
+    {
+        check (RealtimeSafety::allocation, "malloc");
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t num, size_t size) noexcept
+    {
+        check (RealtimeSafety::allocation, "calloc");
+        return __libc_calloc (num, size);
+    }
+
+    void* realloc (void* block, size_t size) noexcept
+    {
+        check (block == nullptr || size > 0 ? RealtimeSafety::allocation : RealtimeSafety::deallocation, "realloc");
+        return __libc_realloc (block, size);
+    }
+
+    void* memalign (size_t alignment, size_t size) noexcept
+    {
+        check (RealtimeSafety::allocation, "memalign");
+        return __libc_memalign (alignment, size);
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size) noexcept
+    {
+        check (RealtimeSafety::allocation, "aligned_alloc");
+        return __libc_memalign (alignment, size);
+    }
+
+    int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+    {
+        check (RealtimeSafety::allocation, "posix_memalign");
+
+        if (alignment % sizeof (void*) != 0 || ! juce::isPowerOfTwo (alignment))
+            return EINVAL;
+
+        auto* block = __libc_memalign (alignment, size);
+
+        if (block == nullptr)
+            return ENOMEM;
+
+        *result = block;
+        return 0;
+    }
+
+    void free (void* block) noexcept
+    {
+        if (block != nullptr)
+            check (RealtimeSafety::deallocation, "free");
+
+        __libc_free (block);
+    }
+
+    //==============================================================================
+    int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::lock, "pthread_mutex_lock");
+        return findNext<decltype (pthread_mutex_lock)> (next, "pthread_mutex_lock") (mutex);
+    }
+
+    int pthread_rwlock_rdlock (pthread_rwlock_t* rwlock) noexcept
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::lock, "pthread_rwlock_rdlock");
+        return findNext<decltype (pthread_rwlock_rdlock)> (next, "pthread_rwlock_rdlock") (rwlock);
+    }
+
+    int pthread_rwlock_wrlock (pthread_rwlock_t* rwlock) noexcept
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::lock, "pthread_rwlock_wrlock");
+        return findNext<decltype (pthread_rwlock_wrlock)> (next, "pthread_rwlock_wrlock") (rwlock);
+    }
+
+    //==============================================================================
+    int pthread_cond_wait (pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "pthread_cond_wait");
+        return findNext<decltype (pthread_cond_wait)> (next, "pthread_cond_wait") (condition, mutex);
+    }
+
+    int pthread_cond_timedwait (pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "pthread_cond_timedwait");
+        return findNext<decltype (pthread_cond_timedwait)> (next, "pthread_cond_timedwait") (condition, mutex, time);
+    }
+
+   #if __GLIBC_PREREQ (2, 30)
+    // What std::condition_variable waits with on a steady clock
+    int pthread_cond_clockwait (pthread_cond_t* condition, pthread_mutex_t* mutex, clockid_t clock, const struct timespec* time)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "pthread_cond_clockwait");
+        return findNext<decltype (pthread_cond_clockwait)> (next, "pthread_cond_clockwait") (condition, mutex, clock, time);
+    }
+   #endif
+
+    int pthread_join (pthread_t thread, void** result)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "pthread_join");
+        return findNext<decltype (pthread_join)> (next, "pthread_join") (thread, result);
+    }
+
+    int sem_wait (sem_t* semaphore)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "sem_wait");
+        return findNext<decltype (sem_wait)> (next, "sem_wait") (semaphore);
+    }
+
+    int nanosleep (const struct timespec* duration, struct timespec* remaining)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "nanosleep");
+        return findNext<decltype (nanosleep)> (next, "nanosleep") (duration, remaining);
+    }
+
+    int clock_nanosleep (clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "clock_nanosleep");
+        return findNext<decltype (clock_nanosleep)> (next, "clock_nanosleep") (clock, flags, time, remaining);
+    }
+
+    int usleep (useconds_t microseconds)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "usleep");
+        return findNext<decltype (usleep)> (next, "usleep") (microseconds);
+    }
+
+    //==============================================================================
+    int open (const char* path, int flags, ...)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "open");
+
+        mode_t mode = 0;
+
+        if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE)
+        {
+            va_list args;
+            va_start (args, flags);
+            mode = (mode_t) va_arg (args, int);
+            va_end (args);
+        }
+
+        return findNext<decltype (open)> (next, "open") (path, flags, mode);
+    }
+
+    ssize_t read (int file, void* buffer, size_t size)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "read");
+        return findNext<decltype (read)> (next, "read") (file, buffer, size);
+    }
+
+    ssize_t write (int file, const void* buffer, size_t size)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "write");
+        return findNext<decltype (write)> (next, "write") (file, buffer, size);
+    }
+
+    int fsync (int file)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "fsync");
+        return findNext<decltype (fsync)> (next, "fsync") (file);
+    }
+
+    int poll (struct pollfd* files, nfds_t numFiles, int timeout)
+    {
+        static std::atomic<void*> next { nullptr };
+        check (RealtimeSafety::blockingCall, "poll");
+        return findNext<decltype (poll)> (next, "poll") (files, numFiles, timeout);
+    }
+}
+
+#else
+
+//==============================================================================
+// Without interposing, replacing the global allocation functions still catches every new and delete
+void* operator new (std::size_t size)
+{
+    RealtimeSafety::check (RealtimeSafety::allocation, "operator new");
+
+    if (auto* block = std::malloc (size > 0 ? size : 1))
+        return block;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    RealtimeSafety::check (RealtimeSafety::allocation, "operator new[]");
+
+    if (auto* block = std::malloc (size > 0 ? size : 1))
+        return block;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeSafety::check (RealtimeSafety::allocation, "operator new");
+    return std::malloc (size > 0 ? size : 1);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeSafety::check (RealtimeSafety::allocation, "operator new[]");
+    return std::malloc (size > 0 ? size : 1);
+}
+
+void operator delete (void* block) noexcept
+{
+    if (block != nullptr)
+        RealtimeSafety::check (RealtimeSafety::deallocation, "operator delete");
+
+    std::free (block);
+}
+
+void operator delete[] (void* block) noexcept
+{
+    if (block != nullptr)
+        RealtimeSafety::check (RealtimeSafety::deallocation, "operator delete[]");
+
+    std::free (block);
+}
+
+void operator delete (void* block, std::size_t) noexcept      { operator delete (block); }
+void operator delete[] (void* block, std::size_t) noexcept    { operator delete[] (block); }
+
+#endif
+#endif
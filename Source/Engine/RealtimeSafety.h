@@ -0,0 +1,100 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// 1 traps realtime-unsafe calls inside a ScopedRealtimeCheck - the CMake option of the same name sets it
+#ifndef DRAWDELAY_REALTIME_CHECKS
+ #define DRAWDELAY_REALTIME_CHECKS 0
+#endif
+
+//==============================================================================
+/*
+    A checker for the code that has to be realtime safe, for debug and CI builds.
+
+    With DRAWDELAY_REALTIME_CHECKS=1, a thread inside a ScopedRealtimeCheck has
+    everything it mustn't do trapped: allocating or freeing memory (malloc, calloc,
+    realloc, free, and so operator new and delete), locking a mutex, and the calls
+    that can block - sleeping, waiting on a condition or semaphore, joining a thread
+    and file I/O. Each one is counted and reported on stderr with a stack trace, and
+    with setFailFast() (or the DRAWDELAY_REALTIME_FAIL_FAST environment variable) the
+    process aborts on the spot, so a debugger or core dump lands right on it.
+
+    Everything is trapped on Linux, where the C library's functions can be
+    interposed. Elsewhere only operator new and delete are.
+
+    Without the flag the scopes are empty, and the normal build is untouched.
+*/
+namespace RealtimeSafety
+{
+    /** What a realtime thread mustn't do - bits, so a ScopedAllowance can let through more than one. */
+    enum Violation
+    {
+        allocation      = 1 << 0,
+        deallocation    = 1 << 1,
+        lock            = 1 << 2,
+        blockingCall    = 1 << 3
+    };
+
+    constexpr int numViolationTypes = 4;
+
+    constexpr bool isChecking = DRAWDELAY_REALTIME_CHECKS != 0;
+
+   #if DRAWDELAY_REALTIME_CHECKS
+    //==============================================================================
+    /** Traps anything realtime-unsafe this thread does while it exists (or does nothing, if shouldCheck is false). */
+    class ScopedRealtimeCheck
+    {
+    public:
+        explicit ScopedRealtimeCheck (bool shouldCheck = true) noexcept;
+        ~ScopedRealtimeCheck() noexcept;
+
+    private:
+        const bool isActive;
+        const int previousAllowance;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedRealtimeCheck)
+    };
+
+    /** Inside a check, lets through the Violation bits given, for a known exception that's been thought about. */
+    class ScopedAllowance
+    {
+    public:
+        explicit ScopedAllowance (int violationsToAllow) noexcept;
+        ~ScopedAllowance() noexcept;
+
+    private:
+        const int previousAllowance;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedAllowance)
+    };
+
+    /** True inside a ScopedRealtimeCheck on this thread - e.g. so work handed to another thread can be checked there too. */
+    bool isCheckingThisThread() noexcept;
+
+    //==============================================================================
+    /** Violations trapped so far on any thread, of every type or just one. */
+    int getNumViolations() noexcept;
+    int getNumViolations (Violation type) noexcept;
+    void resetViolations() noexcept;
+
+    /** Aborts on the first violation rather than reporting it and carrying on. */
+    void setFailFast (bool shouldAbort) noexcept;
+
+   #else
+    struct ScopedRealtimeCheck
+    {
+        explicit ScopedRealtimeCheck (bool = true) noexcept {}
+    };
+
+    struct ScopedAllowance
+    {
+        explicit ScopedAllowance (int) noexcept {}
+    };
+
+    inline bool isCheckingThisThread() noexcept       { return false; }
+    inline int getNumViolations() noexcept            { return 0; }
+    inline int getNumViolations (Violation) noexcept  { return 0; }
+    inline void resetViolations() noexcept            {}
+    inline void setFailFast (bool) noexcept           {}
+   #endif
+}
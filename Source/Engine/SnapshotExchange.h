@@ -0,0 +1,269 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <utility>
+
+//==============================================================================
+/*
+    Hands immutable, reference-counted snapshots from the message thread to the
+    audio thread without locks.
+
+    The message thread publishes a new snapshot by swapping it into a single
+    "pending" slot. The audio thread picks it up at the start of a block with one
+    atomic exchange and pushes the snapshot it was using onto a small SPSC fifo.
+    Everything that leaves the audio thread is released back on the message thread
+    (inside publish() or collectGarbage()), so the audio thread never touches a
+    reference count, allocates or frees anything.
+
+    Snapshots can also be scheduled for a particular time (whatever clock the audio
+    thread counts in - normally samples) on a second SPSC fifo, in time order. The
+    audio thread asks when the next one is due, so it can split its block there, and
+    acquireKeepingPrevious() adopts it once that time comes. Publishing supersedes
+    everything scheduled before it, so an immediate change is never undone by an
+    older scheduled one arriving afterwards.
+
+    ObjectType must inherit from juce::ReferenceCountedObject.
+*/
+template <typename ObjectType>
+class SnapshotExchange
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<ObjectType>;
+
+    SnapshotExchange() = default;
+
+    ~SnapshotExchange()
+    {
+        // The audio callback must have stopped before this is deleted
+        collectGarbage();
+        release (pending.exchange (nullptr));
+        release (previous);
+        release (current);
+
+        for (auto& entry : scheduled)
+            release (entry.object);
+    }
+
+    //==============================================================================
+    /** Message thread: makes newObject the snapshot the audio thread will use from its next block.
+        A snapshot that was published but never picked up is simply dropped.
+    */
+    void publish (Ptr newObject)
+    {
+        jassert (newObject != nullptr); // Publish an empty snapshot rather than nothing
+
+        auto* object = newObject.get();
+        object->incReferenceCount(); // The exchange now holds its own reference
+
+        // Counted before the swap, so the audio thread can't pick this one up and still use anything scheduled before it
+        numPublished.store (numPublished.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        release (pending.exchange (object, std::memory_order_acq_rel));
+        collectGarbage();
+    }
+
+    /** Message thread: makes newObject the snapshot the audio thread will use from time onwards.
+        Times should be in order - one earlier than the last one scheduled waits for that one anyway.
+        Returns false, and holds nothing, if too many are waiting already.
+    */
+    bool schedule (Ptr newObject, juce::int64 time)
+    {
+        jassert (newObject != nullptr);
+
+        collectGarbage();
+
+        if (scheduledFifo.getFreeSpace() == 0)
+            return false;
+
+        auto* object = newObject.get();
+        object->incReferenceCount();
+
+        int start1, size1, start2, size2;
+        scheduledFifo.prepareToWrite (1, start1, size1, start2, size2);
+        scheduled[(size_t) start1] = { object, time, numPublished.load (std::memory_order_relaxed) };
+        scheduledFifo.finishedWrite (1);
+        return true;
+    }
+
+    /** Message thread: releases every snapshot the audio thread has finished with. */
+    void collectGarbage()
+    {
+        int start1, size1, start2, size2;
+        retiredFifo.prepareToRead (retiredFifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            release (std::exchange (retired[(size_t) (start1 + i)], nullptr));
+
+        for (int i = 0; i < size2; ++i)
+            release (std::exchange (retired[(size_t) (start2 + i)], nullptr));
+
+        retiredFifo.finishedRead (size1 + size2);
+    }
+
+    //==============================================================================
+    /** Audio thread: adopts any pending snapshot and returns the one to use for this block.
+        Returns nullptr until something has been published.
+    */
+    ObjectType* acquire() noexcept
+    {
+        return acquire ([] (ObjectType&, ObjectType&) {});
+    }
+
+    /** Audio thread: as above, but calls beforeRetire (previous, next) when a swap happens,
+        while the previous snapshot is still guaranteed to be alive.
+    */
+    template <typename Callback>
+    ObjectType* acquire (Callback&& beforeRetire) noexcept
+    {
+        // Only swap when there's room to hand the old snapshot back, otherwise just
+        // carry on with the current one and try again next block
+        if (pending.load (std::memory_order_relaxed) != nullptr && retiredFifo.getFreeSpace() > 0)
+        {
+            if (auto* next = pending.exchange (nullptr, std::memory_order_acq_rel))
+            {
+                if (auto* previous = std::exchange (current, next))
+                {
+                    beforeRetire (*previous, *next);
+                    retire (previous);
+                }
+            }
+        }
+
+        return current;
+    }
+
+    /** Audio thread: like acquire(), but the snapshot being replaced isn't retired straight away.
+        It stays available from getPrevious() (e.g. to crossfade away from) until releasePrevious(),
+        and no newer snapshot is adopted until then - the latest one published or due just waits.
+
+        Scheduled snapshots due by now are adopted too; if several are, only the latest is used.
+        Calls onSwap (previous, next) when a swap happens.
+    */
+    template <typename Callback>
+    ObjectType* acquireKeepingPrevious (juce::int64 now, Callback&& onSwap) noexcept
+    {
+        if (previous != nullptr)
+            return current;
+
+        ObjectType* next = nullptr;
+
+        if (pending.load (std::memory_order_relaxed) != nullptr)
+        {
+            if ((next = pending.exchange (nullptr, std::memory_order_acq_rel)) != nullptr)
+                numSuperseded = numPublished.load (std::memory_order_acquire);
+        }
+
+        // Anything scheduled before the last publish is dropped, and anything due is taken in order,
+        // as long as there's room to hand back whatever gets skipped over
+        while (scheduledFifo.getNumReady() > 0)
+        {
+            int start1, size1, start2, size2;
+            scheduledFifo.prepareToRead (1, start1, size1, start2, size2);
+            auto& entry = scheduled[(size_t) start1];
+
+            const bool isSuperseded = entry.numPublishedBefore < numSuperseded;
+
+            if (! isSuperseded && entry.time > now)
+                break;
+
+            if ((isSuperseded || next != nullptr) && retiredFifo.getFreeSpace() == 0)
+                break;
+
+            if (isSuperseded)
+                retire (entry.object);
+            else if (auto* skipped = std::exchange (next, entry.object))
+                retire (skipped);
+
+            entry.object = nullptr;
+            scheduledFifo.finishedRead (1);
+        }
+
+        if (next != nullptr)
+        {
+            previous = std::exchange (current, next);
+
+            if (previous != nullptr)
+                onSwap (*previous, *next);
+        }
+
+        return current;
+    }
+
+    /** Audio thread: when the next scheduled snapshot is due, or the largest time there is if nothing's waiting. */
+    juce::int64 getNextScheduledTime() const noexcept
+    {
+        if (scheduledFifo.getNumReady() == 0)
+            return std::numeric_limits<juce::int64>::max();
+
+        int start1, size1, start2, size2;
+        scheduledFifo.prepareToRead (1, start1, size1, start2, size2);
+        return scheduled[(size_t) start1].time;
+    }
+
+    /** Audio thread: the snapshot the last acquire call returned. */
+    ObjectType* getCurrent() const noexcept     { return current; }
+
+    /** Audio thread: the snapshot acquireKeepingPrevious() last replaced, or nullptr once it's been released. */
+    ObjectType* getPrevious() const noexcept    { return previous; }
+
+    /** Audio thread: hands the previous snapshot back to be released on the message thread.
+        Returns false (and keeps hold of it) if there's no room to hand it back yet - try again next block.
+    */
+    bool releasePrevious() noexcept
+    {
+        if (previous == nullptr)
+            return true;
+
+        if (retiredFifo.getFreeSpace() == 0)
+            return false;
+
+        retire (std::exchange (previous, nullptr));
+        return true;
+    }
+
+private:
+    //==============================================================================
+    static void release (ObjectType* object)
+    {
+        if (object != nullptr)
+            object->decReferenceCount();
+    }
+
+    // Audio thread: hands an object back to be released - there must be room
+    void retire (ObjectType* object) noexcept
+    {
+        int start1, size1, start2, size2;
+        retiredFifo.prepareToWrite (1, start1, size1, start2, size2);
+        jassert (size1 == 1);
+        retired[(size_t) start1] = object;
+        retiredFifo.finishedWrite (1);
+    }
+
+    struct ScheduledEntry
+    {
+        ObjectType* object;
+        juce::int64 time;
+        juce::int64 numPublishedBefore; // Anything published after it supersedes it
+    };
+
+    // Enough room to skip every scheduled snapshot at once, even if nothing's been collected since they were scheduled
+    static constexpr int scheduledCapacity = 64;
+    static constexpr int retiredCapacity = scheduledCapacity + 32;
+
+    std::atomic<ObjectType*> pending { nullptr };
+    ObjectType* current = nullptr;  // Only touched by the audio thread (and the destructor)
+    ObjectType* previous = nullptr; // Likewise - only used by acquireKeepingPrevious()
+
+    juce::AbstractFifo retiredFifo { retiredCapacity };
+    std::array<ObjectType*, retiredCapacity> retired {};
+
+    juce::AbstractFifo scheduledFifo { scheduledCapacity };
+    std::array<ScheduledEntry, scheduledCapacity> scheduled {};
+    std::atomic<juce::int64> numPublished { 0 };
+    juce::int64 numSuperseded = 0; // Audio thread only - how many publishes it's picked up
+
+    JUCE_DECLARE_NON_COPYABLE (SnapshotExchange)
+};
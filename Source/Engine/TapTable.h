@@ -0,0 +1,198 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "PartitionedConvolver.h"
+#include "MultiTapKernel.h"
+
+//==============================================================================
+/*
+    An immutable snapshot of the drawn taps.
+
+    The message thread owns the editable arrays in MainComponent; every edit builds
+    a fresh TapTable from them and publishes it through a SnapshotExchange, so the
+    audio thread only ever reads a table that nobody is changing underneath it.
+
+    Everything the audio thread needs is worked out here, for the sample rate the
+    table was built at: the delays in whole samples, sorted so each convolution stage
+    owns a contiguous run of taps, the partition spectra for any stage that's dense
+    enough to be worth convolving, and the taps that feed back into the line.
+
+    Tap times don't have to land on a sample. With interpolation, a tap in between
+    is split into the two (linear) or four (cubic) whole-sample taps either side of
+    it, weighted so they add up to the exact delay, and so the direct kernel and the
+    convolver never need to know. The exact delays are kept as well, in drawn order,
+    for when the taps are moving and have to be read a sample at a time instead.
+*/
+struct TapTable  : public juce::ReferenceCountedObject
+{
+    using Ptr = juce::ReferenceCountedObjectPtr<TapTable>;
+
+    using Interpolation = MultiTapKernel::Interpolation;
+
+    TapTable (const juce::Array<float>& timesMS, const juce::Array<float>& gains, float feedback, int rate,
+              const std::vector<PartitionedConvolver::Stage>& layout, Interpolation interpolationToUse = Interpolation::linear)
+        : sampleRate (rate), interpolation (interpolationToUse)
+    {
+        jassert (timesMS.size() == gains.size());
+
+        exactDelays.ensureStorageAllocated (timesMS.size());
+        exactGains = gains;
+
+        for (auto timeMS : timesMS)
+            exactDelays.add (juce::jmax (0.0, (double) timeMS * sampleRate / 1000.0));
+
+        // Split every tap into the whole-sample taps that read it, then sort those by delay
+        juce::Array<int> splitDelays;
+        juce::Array<float> splitGains;
+
+        for (int i = 0; i < exactDelays.size(); ++i)
+            splitTap (exactDelays[i], gains[i], splitDelays, splitGains);
+
+        juce::Array<int> order;
+
+        for (int i = 0; i < splitDelays.size(); ++i)
+            order.add (i);
+
+        std::stable_sort (order.begin(), order.end(), [&] (int a, int b) { return splitDelays[a] < splitDelays[b]; });
+
+        delaySamples.ensureStorageAllocated (order.size());
+        delayGains.ensureStorageAllocated (order.size());
+
+        for (auto i : order)
+        {
+            delaySamples.add (splitDelays[i]);
+            delayGains.add (splitGains[i]);
+        }
+
+        // The first tap that falls in each convolution stage, then one past the end
+        for (auto& stage : layout)
+            stageTapStart.add ((int) (std::lower_bound (delaySamples.begin(), delaySamples.end(), stage.firstDelay) - delaySamples.begin()));
+
+        stageTapStart.add (size());
+
+        convolution = PartitionedConvolver::createFilter (layout, delaySamples.begin(), delayGains.begin(), stageTapStart.begin());
+
+        createFeedbackTaps (juce::jlimit (0.0f, maximumFeedback, feedback));
+    }
+
+    int size() const noexcept                { return delaySamples.size(); }
+    int getMaximumDelay() const noexcept     { return delaySamples.isEmpty() ? 0 : delaySamples.getLast(); }
+
+    /** The longest block that can be processed in one go - the feedback for a whole block has
+        to come from audio that's already in the line, so no block may be longer than the
+        shortest feedback delay.
+    */
+    int getMaximumFeedbackBlock() const noexcept
+    {
+        return feedbackDelays.isEmpty() ? std::numeric_limits<int>::max() : feedbackDelays.getFirst();
+    }
+
+    int getMaximumFeedbackDelay() const noexcept    { return feedbackDelays.isEmpty() ? 0 : feedbackDelays.getLast(); }
+
+    /** True if the audio thread can slide each of previous's taps over to where it is in this table
+        instead of crossfading - the same taps, no more than maximumMove samples away, and no convolution
+        (moving taps are read one at a time). That's what dragging taps around produces.
+    */
+    bool canGlideFrom (const TapTable& previous, int maximumMove) const noexcept
+    {
+        if (previous.sampleRate != sampleRate || previous.exactDelays.size() != exactDelays.size()
+             || convolution != nullptr || previous.convolution != nullptr)
+            return false;
+
+        for (int i = 0; i < exactDelays.size(); ++i)
+            if (std::abs (exactDelays.getUnchecked (i) - previous.exactDelays.getUnchecked (i)) > maximumMove)
+                return false;
+
+        return true;
+    }
+
+    static constexpr float maximumFeedback = 0.95f;     // Loop gain - anything closer to 1 rings for far too long
+    static constexpr int maximumFeedbackTaps = 8;
+    static constexpr int minimumFeedbackDelay = 32;     // Shorter taps still play, they just don't feed back
+
+    const int sampleRate;
+    const Interpolation interpolation;
+
+    // Every tap's exact delay in samples, and its gain, in the order they were given
+    juce::Array<double> exactDelays;
+    juce::Array<float> exactGains;
+
+    // The whole-sample taps the exact ones are split into, sorted by delay
+    juce::Array<int> delaySamples;
+    juce::Array<float> delayGains;
+
+    juce::Array<int> stageTapStart;
+    std::unique_ptr<PartitionedConvolver::Filter> convolution; // nullptr when every tap goes through the direct kernel
+
+    // The loudest few taps, sorted by delay, also get written back into the delay line.
+    // They're rounded to the nearest sample - interpolating inside the loop would dull every repeat.
+    juce::Array<int> feedbackDelays;
+    juce::Array<float> feedbackGains;
+
+private:
+    void splitTap (double delay, float gain, juce::Array<int>& delays, juce::Array<float>& gains) const
+    {
+        const int whole = (int) delay;
+        const float f = (float) (delay - whole);
+
+        if (interpolation == Interpolation::none || f == 0.0f)
+        {
+            delays.add (interpolation == Interpolation::none ? juce::roundToInt (delay) : whole);
+            gains.add (gain);
+        }
+        else if (interpolation == Interpolation::cubic && whole > 0)
+        {
+            // Lagrange weights for the samples at whole - 1 to whole + 2, the same ones the modulated kernel uses
+            const float a = f * (f - 1.0f), b = (f + 1.0f) * (f - 2.0f);
+            const float weights[] = { -a * (f - 2.0f) / 6.0f, b * (f - 1.0f) * 0.5f, -b * f * 0.5f, a * (f + 1.0f) / 6.0f };
+
+            for (int k = 0; k < 4; ++k)
+            {
+                delays.add (whole - 1 + k);
+                gains.add (gain * weights[k]);
+            }
+        }
+        else
+        {
+            delays.add (whole);
+            gains.add (gain * (1.0f - f));
+            delays.add (whole + 1);
+            gains.add (gain * f);
+        }
+    }
+
+    void createFeedbackTaps (float feedback)
+    {
+        if (feedback <= 0.0f)
+            return;
+
+        juce::Array<int> loudest;
+
+        for (int i = 0; i < exactDelays.size(); ++i)
+            if (juce::roundToInt (exactDelays[i]) >= minimumFeedbackDelay && exactGains[i] != 0.0f)
+                loudest.add (i);
+
+        std::stable_sort (loudest.begin(), loudest.end(), [this] (int a, int b) { return std::abs (exactGains[a]) > std::abs (exactGains[b]); });
+
+        if (loudest.size() > maximumFeedbackTaps)
+            loudest.removeRange (maximumFeedbackTaps, loudest.size() - maximumFeedbackTaps);
+
+        // Back into delay order
+        std::stable_sort (loudest.begin(), loudest.end(), [this] (int a, int b) { return exactDelays[a] < exactDelays[b]; });
+
+        // Share the feedback out in proportion to the drawn gains. The loop gain can't be more than
+        // the sum of their sizes, so scaling that to the feedback amount keeps the network stable.
+        float totalGain = 0.0f;
+
+        for (auto i : loudest)
+            totalGain += std::abs (exactGains[i]);
+
+        for (auto i : loudest)
+        {
+            feedbackDelays.add (juce::roundToInt (exactDelays[i]));
+            feedbackGains.add (feedback * exactGains[i] / totalGain);
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TapTable)
+};
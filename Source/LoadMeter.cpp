@@ -0,0 +1,54 @@
+#include "LoadMeter.h"
+
+//==============================================================================
+LoadMeter::LoadMeter (CallbackProfiler& profilerToShow)
+    : profiler (profilerToShow)
+{
+    startTimerHz (20);
+}
+
+void LoadMeter::timerCallback()
+{
+    profiler.update();
+    repaint();
+}
+
+void LoadMeter::mouseDown (const juce::MouseEvent&)
+{
+    profiler.resetStatistics();
+    repaint();
+}
+
+//==============================================================================
+void LoadMeter::paint (juce::Graphics& g)
+{
+    auto& stats = profiler.getStatistics();
+    auto bounds = getLocalBounds().toFloat();
+    auto barArea = bounds.removeFromTop (bounds.getHeight() / 3).reduced (1.0f);
+
+    // Green while there's plenty of headroom, going red as the callback gets near its deadline
+    const auto load = juce::jlimit (0.0, 100.0, stats.recentLoad);
+    const auto colour = load < 50.0 ? juce::Colours::green : (load < 80.0 ? juce::Colours::orange : juce::Colours::red);
+
+    g.setColour (juce::Colours::black);
+    g.drawRect (barArea);
+    g.setColour (colour);
+    g.fillRect (barArea.reduced (1.0f).withWidth ((barArea.getWidth() - 2.0f) * (float) (load / 100.0)));
+
+    auto percent = [] (double value) { return juce::String (value, 1) + "%"; };
+
+    g.setColour (juce::Colours::black);
+    g.setFont (juce::jmin (14.0f, bounds.getHeight() / 2.5f));
+
+    g.drawText ("Load " + percent (stats.recentLoad) + "   mean " + percent (stats.load.getMean())
+                  + "   p99 " + percent (stats.load.getPercentile (0.99)) + "   max " + percent (stats.load.getMaximum())
+                  + "   xruns " + juce::String (stats.numXruns) + "   overruns " + juce::String (stats.numOverruns),
+                bounds.removeFromTop (bounds.getHeight() / 2), juce::Justification::centredLeft);
+
+    juce::String sections;
+
+    for (int s = 0; s < CallbackProfiler::numSections; ++s)
+        sections << CallbackProfiler::getSectionName (s) << " " << percent (stats.sections[(size_t) s].getPercentile (0.99)) << "   ";
+
+    g.drawText (sections.trimEnd(), bounds, juce::Justification::centredLeft);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Engine/CallbackProfiler.h"
+
+//==============================================================================
+/*
+    Shows how much of each block's time the audio callback is using.
+
+    A timer drains the profiler on the message thread and redraws: the bar is the
+    busiest callback since the last redraw, with the mean and 99th percentile since
+    the last reset (click the meter to reset) and the xrun and overrun counts.
+    The second line breaks the 99th percentile down by section.
+*/
+class LoadMeter  : public juce::Component,
+                   private juce::Timer
+{
+public:
+    explicit LoadMeter (CallbackProfiler& profilerToShow);
+
+    void paint (juce::Graphics& g) override;
+    void mouseDown (const juce::MouseEvent&) override;
+
+private:
+    void timerCallback() override;
+
+    CallbackProfiler& profiler;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadMeter)
+};
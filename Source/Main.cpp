@@ -12,7 +12,6 @@
 // Label the delay box with delay time and gain
 // Make delay time variable
 // Fix audio glitches
-// Have bar that runs across delay box to visualise delay times
 // 
 //Less important:
 //Make circles position (and size?) scalable to the window
@@ -21,6 +20,7 @@
 
 #include <JuceHeader.h>
 #include "MainComponent.h"
+#include "BatchRenderer.h"
 
 //==============================================================================
 class NewProjectApplication  : public juce::JUCEApplication
@@ -38,6 +38,16 @@ public:
     {
         // This method is where you should put your application's initialisation code..
 
+        // Headless mode - render the files on the command line and quit without ever opening a window
+        auto args = getCommandLineParameterArray();
+
+        if (BatchRenderer::isBatchCommandLine (args))
+        {
+            setApplicationReturnValue (BatchRenderer::run (args));
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow (getApplicationName()));
     }
 
@@ -4,6 +4,7 @@
 MainComponent::MainComponent()
 {
     setSize (800, 600);
+    setOpaque (true); // paint() fills everything, so nothing behind needs repainting with us
 
     addAndMakeVisible (undoButton);
     undoButton.setButtonText ("Undo");
@@ -23,74 +24,225 @@ MainComponent::MainComponent()
     volumeSlider.setRange (0, 1.0);
     volumeSlider.addListener (this);
 
+    addAndMakeVisible (feedbackSlider);
+    feedbackSlider.setSliderStyle (juce::Slider::SliderStyle::LinearBarVertical);
+    feedbackSlider.setRange (0, TapTable::maximumFeedback);
+    feedbackSlider.addListener (this);
+
+    addAndMakeVisible (interpolationBox);
+    interpolationBox.addItem ("Nearest sample", 1 + (int) TapTable::Interpolation::none);
+    interpolationBox.addItem ("Linear", 1 + (int) TapTable::Interpolation::linear);
+    interpolationBox.addItem ("Cubic", 1 + (int) TapTable::Interpolation::cubic);
+    interpolationBox.setSelectedId (1 + (int) delayEngine.getInterpolation(), juce::dontSendNotification);
+    interpolationBox.onChange = [this] { interpolationChanged(); };
+
+    addAndMakeVisible (modulationRateSlider);
+    modulationRateSlider.setSliderStyle (juce::Slider::SliderStyle::LinearBar);
+    modulationRateSlider.setRange (0.05, 10.0);
+    modulationRateSlider.setSkewFactorFromMidPoint (1.0);
+    modulationRateSlider.setValue (0.5, juce::dontSendNotification);
+    modulationRateSlider.setTextValueSuffix (" Hz");
+    modulationRateSlider.addListener (this);
+
+    addAndMakeVisible (modulationDepthSlider);
+    modulationDepthSlider.setSliderStyle (juce::Slider::SliderStyle::LinearBar);
+    modulationDepthSlider.setRange (0, DelayEngine::maximumModulationDepthMS);
+    modulationDepthSlider.setTextValueSuffix (" ms wobble");
+    modulationDepthSlider.addListener (this);
+
+    addAndMakeVisible (loadMeter);
+    addAndMakeVisible (csvButton);
+    csvButton.onClick = [this] { csvButtonClicked(); };
+
+    addAndMakeVisible (liveInputButton);
+    liveInputButton.onClick = [this] { liveInputButtonClicked(); };
+
+    addAndMakeVisible (mixFileButton);
+    mixFileButton.onClick = [this] { mixFileWithInput = mixFileButton.getToggleState(); };
+    mixFileButton.setEnabled (false);
+
+    addAndMakeVisible (settingsButton);
+    settingsButton.onClick = [this] { settingsButtonClicked(); };
+
+    addAndMakeVisible (latencyLabel);
+
+    addAndMakeVisible (presetBox);
+    presetBox.setTextWhenNothingSelected ("Presets (keys 1-9)");
+    presetBox.setTextWhenNoChoicesAvailable ("No presets loaded");
+    presetBox.onChange = [this] { selectPreset (presetBox.getSelectedItemIndex()); };
+
+    addAndMakeVisible (savePresetButton);
+    savePresetButton.onClick = [this] { savePresetButtonClicked(); };
+
+    addAndMakeVisible (loadPresetButton);
+    loadPresetButton.onClick = [this] { loadPresetButtonClicked(); };
+
+    addAndMakeVisible (delayBoxOverlay); // Under the lasso, which has to be on top
+    addChildComponent (lasso); // For rubber-band selecting taps
+
+    // Only the taps whose selection changed get redrawn
+    selectedTaps.onChange = [this] (int index, bool isSelected)
+    {
+        if (juce::isPositiveAndBelow (index, mousePosArray.size()))
+        {
+            tapIsSelected[(size_t) index] = isSelected;
+            redrawTaps (getTapBounds (mousePosArray[index]));
+        }
+    };
+    setWantsKeyboardFocus (true);
+
     formatManager.registerBasicFormats(); // Register audio formats
+    readAheadThread.startThread (3);
+
+    delayEngine.setWorkerPool (workerPool.get()); // Big multichannel blocks get their channels spread over the cores
+    publishTaps(); // Make sure the audio thread always has a (possibly empty) tap table
+    startTimerHz (garbageCollectionHz);
 
     // Some platforms require permissions to open input channels so request that here
     if (juce::RuntimePermissions::isRequired (juce::RuntimePermissions::recordAudio)
         && ! juce::RuntimePermissions::isGranted (juce::RuntimePermissions::recordAudio))
     {
         juce::RuntimePermissions::request (juce::RuntimePermissions::recordAudio,
-                                           [&] (bool granted) { setAudioChannels (granted ? 2 : 0, 2); });
+                                           [&] (bool granted) { openAudioChannels (granted); });
     }
     else
     {
-        // Specify the number of input and output channels that we want to open
-        setAudioChannels (2, 2);
+        openAudioChannels (true);
     }
 }
 
 MainComponent::~MainComponent()
 {
+    stopTimer();
+
     // This shuts down the audio device and clears the audio source.
     shutdownAudio();
 }
 
+void MainComponent::openAudioChannels (bool inputAllowed)
+{
+    // Stereo gets the default device going...
+    setAudioChannels (inputAllowed ? 2 : 0, 2);
+
+    auto* device = deviceManager.getCurrentAudioDevice();
+
+    if (device == nullptr)
+        return;
+
+    // ...then everything it has is opened, as the engine runs a delay line per channel however many there are
+    const int numInputs = inputAllowed ? device->getInputChannelNames().size() : 0;
+    const int numOutputs = device->getOutputChannelNames().size();
+
+    auto setup = deviceManager.getAudioDeviceSetup();
+
+    if (setup.inputChannels.countNumberOfSetBits() >= numInputs && setup.outputChannels.countNumberOfSetBits() >= numOutputs)
+        return;
+
+    setup.useDefaultInputChannels = false;
+    setup.useDefaultOutputChannels = false;
+    setup.inputChannels.setRange (0, numInputs, true);
+    setup.outputChannels.setRange (0, numOutputs, true);
+
+    auto error = deviceManager.setAudioDeviceSetup (setup, true);
+    jassert (error.isEmpty()); // The device offered these channels, so it should be able to open them
+    juce::ignoreUnused (error);
+}
+
 //==============================================================================
 void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
 {
     transportSource.prepareToPlay (samplesPerBlockExpected, sampleRate);
+    profiler.prepare (sampleRate);
+
+    const bool sampleRateChanged = delayEngine.getSampleRate() != (int) sampleRate;
+
+    // One delay line per output channel the device actually has open, rather than assuming stereo
+    int numChannels = 2;
 
-    delayBuffer.setSize (2, maximumDelayTimeS * (samplesPerBlockExpected + sampleRate), false, true);
-    globalSampleRate = sampleRate;
+    if (auto* device = deviceManager.getCurrentAudioDevice())
+        numChannels = juce::jmax (1, device->getActiveOutputChannels().countNumberOfSetBits());
+
+    delayEngine.prepare (sampleRate, samplesPerBlockExpected, numChannels);
+
+    // Allocated here so live mode never allocates in the callback - bigger blocks are mixed in pieces this size
+    fileBuffer.setSize (numChannels, juce::jmax (1, samplesPerBlockExpected));
+
+    // The published taps are in samples, so they need rebuilding if the rate has changed - the latency readout always does
+    if (sampleRateChanged)
+    {
+        presetsNeedCompiling = true;
+        tapsNeedRepublishing = true;
+    }
+
+    triggerAsyncUpdate();
 }
 
 void MainComponent::getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill)
 {
-    if (readerSource.get() == nullptr) // Check for valid reader source
+    // In a DRAWDELAY_REALTIME_CHECKS build, anything in here that could block the audio thread is trapped
+    RealtimeSafety::ScopedRealtimeCheck realtimeCheck;
+
+    profiler.beginCallback();
+
+    const bool liveInput = useLiveInput.load();
+
+    LevelFifo::Block levels { 0.0f, 0.0f, bufferToFill.numSamples };
+
+    if (! liveInput && readerSource.get() == nullptr) // Nothing to play
     {
         bufferToFill.clearActiveBufferRegion();
-        return;
     }
-    
-    transportSource.getNextAudioBlock (bufferToFill);
-    
-    // Declaring these for readability
-    const int bufferLength = bufferToFill.buffer->getNumSamples();
-    const int delayBufferLength = delayBuffer.getNumSamples();
-
-    for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+    else
     {
-        const float* bufferData = bufferToFill.buffer->getReadPointer(channel);
-        const float* delayBufferData = delayBuffer.getReadPointer(channel);
-        float* dryBuffer = bufferToFill.buffer->getWritePointer(channel);
+        {
+            CallbackProfiler::ScopedSection section (profiler, CallbackProfiler::transportRead);
+
+            // The transport and its read-ahead buffer each hold a lock for a moment, only ever contended by
+            // a seek from the message thread - anything else they do is still trapped
+            RealtimeSafety::ScopedAllowance transportLocks (RealtimeSafety::lock);
+
+            // In live mode the device has already put its input in the buffer, so it's processed right where it is
+            if (! liveInput)
+                transportSource.getNextAudioBlock (bufferToFill);
+            else if (mixFileWithInput.load() && readerSource.get() != nullptr)
+                mixFileInto (bufferToFill);
+        }
+
+        levels.inputPeak = bufferToFill.buffer->getMagnitude (bufferToFill.startSample, bufferToFill.numSamples);
+
+        // Add the delays - see DelayEngine for the circular buffer
+        delayEngine.process (*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
 
-        fillDelayBuffer(channel, bufferLength, delayBufferLength, bufferData, delayBufferData);
-        getFromDelayBuffer(*bufferToFill.buffer, channel, bufferLength, delayBufferLength, bufferData, delayBufferData); 
-        //feedbackDelay(channel, bufferLength, delayBufferLength, dryBuffer);
+        const auto engineTimes = delayEngine.getLastProcessTimes();
+        profiler.addSectionTime (CallbackProfiler::fillDelayBuffer, engineTimes.fillTicks);
+        profiler.addSectionTime (CallbackProfiler::getFromDelayBuffer, engineTimes.readTicks);
+
+        // Apply slider volume
+        CallbackProfiler::ScopedSection section (profiler, CallbackProfiler::applyGain);
+        bufferToFill.buffer->applyGain (bufferToFill.startSample, bufferToFill.numSamples, volumeSlider.getValue());
+
+        levels.outputPeak = bufferToFill.buffer->getMagnitude (bufferToFill.startSample, bufferToFill.numSamples);
     }
 
-    writePosition += bufferLength; // When buffer has been processed, move write position to the next value so it becomes e.g. 513 not 0 again
-    writePosition %= delayBufferLength; // Look below for explanation
-    /*
-    This has the effect of wrapping the value back around to 0.
-    So when delayBufferLength gets to its maximum value, mWritePosition will become the same number as delayBufferLength
-    So modulo divides mWritePosition by delayBufferLength which is the same as dividing it by itself.
-    Dividing by itself = 1 with remainder 0.
-    So mWritePosition becomes 0.
-    */
+    // A block of silence still moves the display on
+    levelFifo.push (levels);
+
+    profiler.endCallback (bufferToFill.numSamples, deviceManager.getXRunCount());
+}
+
+void MainComponent::mixFileInto (const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    const int numChannels = juce::jmin (fileBuffer.getNumChannels(), bufferToFill.buffer->getNumChannels());
+
+    for (int done = 0; done < bufferToFill.numSamples; done += fileBuffer.getNumSamples())
+    {
+        const int numSamples = juce::jmin (fileBuffer.getNumSamples(), bufferToFill.numSamples - done);
 
-    // Apply slider volume
-    bufferToFill.buffer->applyGain (volumeSlider.getValue());
+        transportSource.getNextAudioBlock (juce::AudioSourceChannelInfo (&fileBuffer, 0, numSamples));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            bufferToFill.buffer->addFrom (channel, bufferToFill.startSample + done, fileBuffer, channel, 0, numSamples);
+    }
 }
 
 void MainComponent::releaseResources()
@@ -107,38 +259,83 @@ void MainComponent::releaseResources()
 void MainComponent::paint (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
+    // JUCE clips this to the area being repainted, so an edit only costs the pixels around the tap that changed
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
 
+    g.setColour (juce::Colours::black);
     g.drawRect(delayBox);
 
-    for (int i = 0; i < mousePosArray.size(); i++)
+    // The taps themselves were drawn into the cached layer as they changed
+    g.drawImageAt (tapLayer, (int) delayBox.getX(), (int) delayBox.getY());
+}
+
+juce::Rectangle<float> MainComponent::getTapBounds (juce::Point<float> position) const
+{
+    // Get the circle's top left corner
+    float mouseX = position.getX() - 5; // - 5 to centre circle on mouse
+    float mouseY = position.getY() - 5;
+
+    // Big if statement to make sure the circles don't overlap the box's bounds
+    if (position.getX() < (delayBox.getX() + 5)) // If click is less across than box's x position + 5
+    {
+        mouseX = delayBox.getX(); // Set dot's X to the edge of the box
+        // Don't need to change this box X value because the circles are drawn from the top left corner
+    }
+    if (position.getX() > (delayBox.getRight() - 5)) // Right
     {
-        // Get array member of all circles
-        int mouseX = mousePosArray.operator[](i).getX() - 5; // - 5 to centre circle on mouse
-        int mouseY = mousePosArray.operator[](i).getY() - 5;
+        mouseX = delayBox.getRight() - 10;
+    }
+    if (position.getY() < (delayBox.getY() + 5)) // Top
+    {
+        mouseY = delayBox.getY(); 
+    }
+    if (position.getY() > (delayBox.getBottom() - 5)) // Bottom
+    {
+        mouseY = delayBox.getBottom() - 10;
+    }
 
-        // Big if statement to make sure the circles don't overlap the box's bounds
-        if (mousePosArray.operator[](i).getX() < (delayBox.getX() + 5)) // If click is less across than box's x position + 5
-        {
-            mouseX = delayBox.getX(); // Set dot's X to the edge of the box
-            // Don't need to change this box X value because the circles are drawn from the top left corner
-        }
-        if (mousePosArray.operator[](i).getX() > (delayBox.getRight() - 5)) // Right
-        {
-            mouseX = delayBox.getRight() - 10;
-        }
-        if (mousePosArray.operator[](i).getY() < (delayBox.getY() + 5)) // Top
-        {
-            mouseY = delayBox.getY(); 
-        }
-        if (mousePosArray.operator[](i).getY() > (delayBox.getBottom() - 5)) // Bottom
+    // Whole pixels, like the circles have always been drawn
+    return { (float) (int) mouseX, (float) (int) mouseY, tapSize, tapSize };
+}
+
+void MainComponent::redrawTaps (juce::Rectangle<float> area)
+{
+    if (! tapLayer.isValid())
+        return;
+
+    // Wipe the area (plus a pixel for anti-aliasing) and draw back whatever taps overlap it - the grid finds them without looking at the rest
+    const auto dirty = area.getSmallestIntegerContainer().expanded (1).getIntersection (delayBox.toNearestInt());
+    const auto origin = delayBox.getPosition().toInt();
+
+    tapLayer.clear (dirty - origin);
+
+    juce::Graphics g (tapLayer);
+    g.setOrigin (-origin);
+    g.reduceClipRegion (dirty);
+
+    juce::Array<int> overlapping;
+    tapGrid.findTapsIn (dirty.toFloat().expanded (tapSize), overlapping);
+
+    for (auto index : overlapping)
+    {
+        auto bounds = getTapBounds (mousePosArray[index]);
+
+        if (bounds.intersects (dirty.toFloat()))
         {
-            mouseY = delayBox.getBottom() - 10;
+            g.setColour (tapIsSelected[(size_t) index] ? juce::Colours::orange : juce::Colours::black);
+            g.fillEllipse (bounds); // Draw circle
         }
-        
-
-        g.fillEllipse(mouseX, mouseY, 10, 10); // Draw circle
     }
+
+    // The overlay only repaints a tap's meter when its level changes, so one that's moved or gone needs repainting here
+    repaint (dirty.getUnion (DelayBoxOverlay::getMeterArea (area.getCentre()).expanded (tapSize / 2.0f).getSmallestIntegerContainer()));
+}
+
+void MainComponent::rebuildTapLayer()
+{
+    // Only when the box changes size - everything else is redrawn a tap at a time
+    tapLayer = juce::Image (juce::Image::ARGB, juce::jmax (1, (int) delayBox.getWidth()), juce::jmax (1, (int) delayBox.getHeight()), true);
+    redrawTaps (delayBox);
 }
 
 void MainComponent::resized()
@@ -151,176 +348,680 @@ void MainComponent::resized()
     openButton.setBounds (juce::Component::getWidth() / 1.4, juce::Component::getHeight() / 3, juce::Component::getWidth() / 10, juce::Component::getWidth() / 10);
     playButton.setBounds (juce::Component::getWidth() / 1.4, juce::Component::getHeight() / 2.05, juce::Component::getWidth() / 10, juce::Component::getWidth() / 10);
     volumeSlider.setBounds (juce::Component::getWidth() / 1.4, juce::Component::getHeight() / 1.5, juce::Component::getWidth() / 10, juce::Component::getWidth() / 10);
+    feedbackSlider.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 1.5, juce::Component::getWidth() / 10, juce::Component::getWidth() / 10);
+    loadMeter.setBounds (juce::Component::getWidth() / 8, juce::Component::getHeight() / 1.4, juce::Component::getWidth() / 1.8, juce::Component::getHeight() / 10);
+    csvButton.setBounds (juce::Component::getWidth() / 8, juce::Component::getHeight() / 1.2, juce::Component::getWidth() / 4, 24);
+    latencyLabel.setBounds (juce::Component::getWidth() / 8, juce::Component::getHeight() / 1.2 + 28, juce::Component::getWidth() / 1.8, 24);
+    liveInputButton.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 8, juce::Component::getWidth() / 8, 24);
+    mixFileButton.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 8 + 28, juce::Component::getWidth() / 8, 24);
+    settingsButton.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 3, juce::Component::getWidth() / 10, juce::Component::getWidth() / 10);
+    interpolationBox.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 2.05, juce::Component::getWidth() / 8, 24);
+    modulationRateSlider.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 2.05 + 28, juce::Component::getWidth() / 8, 24);
+    modulationDepthSlider.setBounds (juce::Component::getWidth() / 1.15, juce::Component::getHeight() / 2.05 + 56, juce::Component::getWidth() / 8, 24);
+    presetBox.setBounds (juce::Component::getWidth() / 8, juce::Component::getHeight() / 1.55, juce::Component::getWidth() / 4, 24);
+    savePresetButton.setBounds (presetBox.getRight() + 8, presetBox.getY(), juce::Component::getWidth() / 8, 24);
+    loadPresetButton.setBounds (savePresetButton.getRight() + 8, presetBox.getY(), juce::Component::getWidth() / 8, 24);
 
     delayBox.setX (juce::Component::getWidth() / 8);       // Box X position
     delayBox.setY (juce::Component::getHeight() / 8);      // Box Y position
     delayBox.setWidth (juce::Component::getWidth() / 2);   // Box width
     delayBox.setHeight (juce::Component::getHeight() / 2); // Box height
+    delayBoxOverlay.setBounds (delayBox.toNearestInt());
+
+    rebuildTapLayer();
 }
 
 void MainComponent::mouseDown (const juce::MouseEvent& ev)
 {
+    pressedTap = -1;
+    isLassoing = false;
+
     // Use bounds of box to make width and height for readability 
     int width = delayBox.getX() + delayBox.getWidth();
     int height = delayBox.getY() + delayBox.getHeight();
 
-    bool removing = false;
-
     // If click is within the box's bounds
     if (ev.position.x > delayBox.getX() && ev.position.x < width && ev.position.y > delayBox.getY() && ev.position.y < height)
     {
-        // Search array 
-        for (int i = 0; i < mousePosArray.size(); i++)
+        // Only the taps in the grid cells around the click get looked at, and only one of them can be hit
+        pressedTap = tapGrid.findTapAt (ev.position, tapSize / 2);
+
+        if (pressedTap >= 0)
+        {
+            // Dragging a tap moves the whole selection with it
+            selectOnMouseUp = selectedTaps.addToSelectionOnMouseDown (pressedTap, ev.mods);
+
+            dragStartPositions.clearQuick();
+
+            for (auto index : selectedTaps)
+                dragStartPositions.add (mousePosArray[index]);
+        }
+        else
+        {
+            // Clicking empty space adds a tap on mouse up - dragging selects with a rubber band instead
+            isLassoing = true;
+            lasso.beginLasso (ev, this);
+        }
+    }
+}
+
+void MainComponent::mouseDrag (const juce::MouseEvent& ev)
+{
+    if (! ev.mouseWasDraggedSinceMouseDown())
+        return;
+
+    if (isLassoing)
+    {
+        lasso.dragLasso (ev);
+    }
+    else if (pressedTap >= 0)
+    {
+        // Keep every tap inside the box, so its time and gain stay in range
+        auto offset = ev.getOffsetFromDragStart().toFloat();
+        auto limits = delayBox.reduced (0.5f);
+
+        for (int i = 0; i < selectedTaps.getNumSelected(); ++i)
+            moveTap (selectedTaps.getSelectedItem (i), limits.getConstrainedPoint (dragStartPositions[i] + offset));
+
+        // Each step of the drag is heard as far apart as it was made, not whenever the message loop got to it
+        scheduleTaps (ev.eventTime);
+    }
+}
+
+void MainComponent::mouseUp (const juce::MouseEvent& ev)
+{
+    if (isLassoing)
+    {
+        lasso.endLasso();
+
+        if (! ev.mouseWasDraggedSinceMouseDown())
         {
-            // If the click position is within the bounds of a drawn cirle in the array
-            if ((juce::Range<float>(mousePosArray[i].getX() - 5, mousePosArray[i].getX() + 5).contains(ev.position.getX())) && (juce::Range<float>(mousePosArray[i].getY() - 5, mousePosArray[i].getY() + 5).contains(ev.position.getY())))
-            {
-                // Debugging 
-                DBG("\nRemoving:");
-                DBG("mouse = " << ev.position.getX() << ", " << ev.position.getY());
-                DBG("circle = " << mousePosArray[i].getX() << ", " << mousePosArray[i].getY());
-
-                // Remove element from array 
-                mousePosArray.remove(i);
-
-                // Remove from delay arrays
-                delayTimesMS.remove(i);
-                delayGains.remove(i);
-
-                repaint();
-                removing = true;
-            }
+            selectedTaps.deselectAll();
+            performTapEdit ({}, { ev.position });
         }
+    }
+    else if (pressedTap >= 0)
+    {
+        if (ev.mouseWasDraggedSinceMouseDown())
+        {
+            // The taps have already moved, so this only records where they went for undo
+            juce::Array<juce::Point<float>> endPositions;
+
+            for (auto index : selectedTaps)
+                endPositions.add (mousePosArray[index]);
 
-        if (removing == false)
+            performTapEdit (dragStartPositions, endPositions, true);
+        }
+        else if (ev.mods.isAnyModifierKeyDown())
+        {
+            selectedTaps.addToSelectionOnMouseUp (pressedTap, ev.mods, false, selectOnMouseUp);
+        }
+        else
         {
-            mousePosArray.add(ev.position); // Add mouse click coordinates to array of points
-
-            // Map x coordinate to delayTimesMS value
-            int timeRange = maximumDelayTimeS * 1000;
-            float xCoordRange = (delayBox.getX() + delayBox.getWidth()) - delayBox.getX();
-            int newTime = (((ev.position.getX() - delayBox.getX()) * timeRange) / xCoordRange);
-            delayTimesMS.add(newTime);
-
-            // Map y coordinate to delayGains value
-            float gainRange = 1.0;
-            float yCoordRange = (delayBox.getY() + delayBox.getHeight()) - delayBox.getY();
-            float newGain = (((ev.position.getY() - delayBox.getY()) * gainRange) / yCoordRange);
-            newGain = 1 - newGain; // Invert range
-            delayGains.add(newGain);
-
-            // Debugging
-            DBG("\nAdding:");
-            DBG("mouse = " << ev.position.getX() << ", " << ev.position.getY());
-            DBG("circle = " << mousePosArray.getLast().getX() << ", " << mousePosArray.getLast().getY());
-            DBG("delay = " << newTime << "ms");
-            DBG("gain = " << newGain);
-
-            repaint();
+            // A plain click on a tap removes it, the same as it always has
+            performTapEdit ({ mousePosArray[pressedTap] }, {});
         }
     }
+
+    pressedTap = -1;
+    isLassoing = false;
 }
 
-void MainComponent::undoButtonClicked()
+bool MainComponent::keyPressed (const juce::KeyPress& key)
 {
-    // If circles have been drawn
-    if (mousePosArray.size() > 0)
+    if (key == juce::KeyPress::deleteKey || key == juce::KeyPress::backspaceKey)
+    {
+        deleteSelectedTaps();
+        return true;
+    }
+
+    if (key == juce::KeyPress ('z', juce::ModifierKeys::commandModifier, 0))
     {
-        // Remove them
-        int element = mousePosArray.size() - 1; // -1 because element index starts at 0
-        mousePosArray.remove(element);
-        delayTimesMS.remove(element);
-        delayGains.remove(element);
-        repaint();
+        undoButtonClicked();
+        return true;
     }
+
+    if (key == juce::KeyPress ('z', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0))
+    {
+        undoManager.redo();
+        return true;
+    }
+
+    // The number keys switch straight to the first nine presets
+    const auto character = key.getTextCharacter();
+
+    if (character >= '1' && character <= '9' && ! key.getModifiers().isAnyModifierKeyDown())
+    {
+        const int index = (int) (character - '1');
+
+        if (index < (int) presets.size())
+            presetBox.setSelectedItemIndex (index); // Calls selectPreset()
+
+        return true;
+    }
+
+    return false;
 }
 
-void MainComponent::openButtonClicked()
+void MainComponent::undoButtonClicked()
 {
-    // Declare file chooser and make sure it can only open mp3s
-    juce::FileChooser chooser("Select an mp3 file to play...", {}, "*.mp3");
+    // Every add, remove and drag is its own transaction, so this takes back the last edit
+    undoManager.undo();
+}
 
-    // Open file chooser - if succeeds if user actually selects a file rather than cancelling
-    if (chooser.browseForFileToOpen())                                          
+//==============================================================================
+struct MainComponent::TapEditAction  : public juce::UndoableAction
+{
+    TapEditAction (MainComponent& o, const juce::Array<juce::Point<float>>& r, const juce::Array<juce::Point<float>>& a, bool done)
+        : owner (o), removed (r), added (a), alreadyDone (done)
     {
-        auto file = chooser.getResult(); // Get file                                      
-        auto* reader = formatManager.createReaderFor (file); // Create a reader to read the file - is new because it needs to be deleted when out of scope.
+    }
+
+    bool perform() override
+    {
+        if (alreadyDone) // A drag has already moved the taps by the time it's recorded
+            alreadyDone = false;
+        else
+            apply (removed, added);
+
+        return true;
+    }
 
-        if (reader != nullptr) // If reader works - returns nullptr if file is not a format that AudioFormatManager can handle
+    bool undo() override
+    {
+        apply (added, removed);
+        return true;
+    }
+
+    int getSizeInUnits() override
+    {
+        return 1 + removed.size() + added.size();
+    }
+
+    // Indices change as taps come and go, but positions don't - any tap at the right spot will do
+    void apply (const juce::Array<juce::Point<float>>& toRemove, const juce::Array<juce::Point<float>>& toAdd)
+    {
+        // Indices are about to move about, so a selection wouldn't mean anything afterwards
+        owner.selectedTaps.deselectAll();
+
+        for (auto& position : toRemove)
         {
-            std::unique_ptr<juce::AudioFormatReaderSource> newSource (new juce::AudioFormatReaderSource (reader, true)); // Make new source
-            // - declare as a unique ptr to avoid deleting previously allocated AudioFormatReaderSource on subsequent open file commands
-            transportSource.setSource (newSource.get(), 0, nullptr, reader->sampleRate); // Connect reader to AudioTransportSource for use in getNextAudioBlock()                                
-            playButton.setEnabled (true);                                                                                
-            readerSource.reset (newSource.release()); // Safely release source resources as we have passed newSource's data on                                                                     
+            auto index = owner.tapGrid.findTapExactlyAt (position);
+
+            if (index >= 0)
+                owner.removeTap (index);
         }
+
+        for (auto& position : toAdd)
+            owner.addTap (position);
+
+        owner.tapsChanged();
     }
+
+    MainComponent& owner;
+    const juce::Array<juce::Point<float>> removed, added;
+    bool alreadyDone;
+};
+
+void MainComponent::performTapEdit (const juce::Array<juce::Point<float>>& removed, const juce::Array<juce::Point<float>>& added, bool alreadyDone)
+{
+    undoManager.beginNewTransaction();
+    undoManager.perform (new TapEditAction (*this, removed, added, alreadyDone));
+
+    if (alreadyDone) // Moving doesn't change any indices, so the dragged taps stay selected
+        tapsChanged();
 }
 
-void MainComponent::playButtonClicked()
+void MainComponent::deleteSelectedTaps()
 {
-    transportSource.setPosition(0); // Reset the file position
-    transportSource.start(); // Start playback
+    juce::Array<juce::Point<float>> removed;
+
+    for (auto index : selectedTaps)
+        removed.add (mousePosArray[index]);
+
+    if (! removed.isEmpty())
+        performTapEdit (removed, {});
 }
 
-void MainComponent::sliderValueChanged(juce::Slider* volumeSlider) {}
+//==============================================================================
+void MainComponent::addTap (juce::Point<float> position)
+{
+    tapGrid.add (mousePosArray.size(), position);
+    mousePosArray.add (position); // Add mouse click coordinates to array of points
+    tapIsSelected.push_back (false);
+
+    delayTimesMS.add (getTimeMSFor (position));
+    delayGains.add (getGainFor (position));
+
+    // Debugging
+    DBG("\nAdding:");
+    DBG("circle = " << position.getX() << ", " << position.getY());
+    DBG("delay = " << delayTimesMS.getLast() << "ms");
+    DBG("gain = " << delayGains.getLast());
+
+    redrawTaps (getTapBounds (position));
+}
 
-void MainComponent::fillDelayBuffer(int channel, const int bufferLength, const int delayBufferLength, const float* bufferData, const float* delayBufferData)
+void MainComponent::removeTap (int index)
 {
-    // Copy data from main buffer to delay buffer - this is a bit fiddly because the buffers are different lengths
-    
-    // This if alone won't fill the buffer because buffer is smaller than mDelayBuffer 
-    if (delayBufferLength > bufferLength + writePosition)
+    jassert (juce::isPositiveAndBelow (index, mousePosArray.size()));
+
+    DBG("\nRemoving:");
+    DBG("circle = " << mousePosArray[index].getX() << ", " << mousePosArray[index].getY());
+
+    tapGrid.remove (index, mousePosArray[index]);
+    const auto removedBounds = getTapBounds (mousePosArray[index]);
+
+    // Fill the gap with the last tap rather than shuffling everything after it down - the engine sorts them anyway
+    const int last = mousePosArray.size() - 1;
+
+    if (index != last)
     {
-        delayBuffer.copyFromWithRamp(channel, writePosition, bufferData, bufferLength, 1.0, 1.0);
+        tapGrid.reindex (last, index, mousePosArray[last]);
+        mousePosArray.set (index, mousePosArray[last]);
+        delayTimesMS.set (index, delayTimesMS[last]);
+        delayGains.set (index, delayGains[last]);
+        tapIsSelected[(size_t) index] = tapIsSelected[(size_t) last];
     }
-    // So we have to catch the rest of them - look at TAP delay pt 1 tutorial for explanation of this
-    else
+
+    mousePosArray.removeLast();
+    delayTimesMS.removeLast();
+    delayGains.removeLast();
+    tapIsSelected.pop_back();
+
+    redrawTaps (removedBounds);
+}
+
+void MainComponent::moveTap (int index, juce::Point<float> newPosition)
+{
+    const auto oldBounds = getTapBounds (mousePosArray[index]);
+
+    tapGrid.move (index, mousePosArray[index], newPosition);
+    mousePosArray.set (index, newPosition);
+    delayTimesMS.set (index, getTimeMSFor (newPosition));
+    delayGains.set (index, getGainFor (newPosition));
+
+    redrawTaps (oldBounds);
+    redrawTaps (getTapBounds (newPosition));
+}
+
+float MainComponent::getTimeMSFor (juce::Point<float> position) const
+{
+    // Map x coordinate to delayTimesMS value
+    float timeRange = maximumDelayTimeS * 1000;
+    float xCoordRange = (delayBox.getX() + delayBox.getWidth()) - delayBox.getX();
+    return (((position.getX() - delayBox.getX()) * timeRange) / xCoordRange);
+}
+
+float MainComponent::getGainFor (juce::Point<float> position) const
+{
+    // Map y coordinate to delayGains value
+    float gainRange = 1.0;
+    float yCoordRange = (delayBox.getY() + delayBox.getHeight()) - delayBox.getY();
+    float newGain = (((position.getY() - delayBox.getY()) * gainRange) / yCoordRange);
+    return 1 - newGain; // Invert range
+}
+
+void MainComponent::tapsChanged()
+{
+    // The drawing has already been done a tap at a time
+    publishTaps();
+
+    // It's not the preset any more, and choosing the preset again should go back to it
+    presetBox.setSelectedId (0, juce::dontSendNotification);
+}
+
+//==============================================================================
+TapPattern MainComponent::getCurrentPattern() const
+{
+    TapPattern pattern;
+    pattern.delayTimesMS = delayTimesMS;
+    pattern.delayGains = delayGains;
+    pattern.feedback = (float) feedbackSlider.getValue();
+    return pattern;
+}
+
+void MainComponent::setPattern (const TapPattern& pattern)
+{
+    selectedTaps.deselectAll();
+    undoManager.clearUndoHistory(); // The recorded edits were to a different drawing
+
+    tapGrid.clear();
+    mousePosArray.clearQuick();
+    delayTimesMS.clearQuick();
+    delayGains.clearQuick();
+    tapIsSelected.clear();
+
+    // The exact times and gains go in the arrays - mapping a position back could be a fraction out
+    for (int i = 0; i < pattern.size(); ++i)
+    {
+        auto position = getPositionFor (pattern.delayTimesMS[i], pattern.delayGains[i]);
+
+        tapGrid.add (i, position);
+        mousePosArray.add (position);
+        tapIsSelected.push_back (false);
+        delayTimesMS.add (pattern.delayTimesMS[i]);
+        delayGains.add (pattern.delayGains[i]);
+    }
+
+    feedbackSlider.setValue (pattern.feedback, juce::dontSendNotification);
+    rebuildTapLayer();
+}
+
+void MainComponent::addPreset (const TapPattern& pattern)
+{
+    // All the work of switching to a preset happens here, off the audio thread
+    presets.push_back ({ pattern, delayEngine.createTapTable (pattern.delayTimesMS, pattern.delayGains, pattern.feedback) });
+    presetBox.addItem (juce::String ((int) presets.size()) + ": " + pattern.name, (int) presets.size());
+}
+
+void MainComponent::selectPreset (int index)
+{
+    if (! juce::isPositiveAndBelow (index, (int) presets.size()))
+        return;
+
+    auto& preset = presets[(size_t) index];
+    setPattern (preset.pattern);
+
+    // Already compiled, so the audio thread just swaps to it and crossfades
+    delayEngine.setTaps (preset.table);
+}
+
+void MainComponent::compilePresets()
+{
+    for (auto& preset : presets)
+        preset.table = delayEngine.createTapTable (preset.pattern.delayTimesMS, preset.pattern.delayGains, preset.pattern.feedback);
+}
+
+juce::Point<float> MainComponent::getPositionFor (float timeMS, float gain) const
+{
+    // The inverse of getTimeMSFor() and getGainFor(), kept inside the box in case a hand-edited preset isn't
+    const float x = delayBox.getX() + timeMS * delayBox.getWidth() / (maximumDelayTimeS * 1000);
+    const float y = delayBox.getY() + (1.0f - gain) * delayBox.getHeight();
+    return delayBox.reduced (0.5f).getConstrainedPoint ({ x, y });
+}
+
+void MainComponent::savePresetButtonClicked()
+{
+    fileChooser = std::make_unique<juce::FileChooser> ("Save taps as...", juce::File(),
+                                                       juce::String ("*") + TapPattern::binaryFileExtension + ";*" + TapPattern::xmlFileExtension);
+
+    fileChooser->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                | juce::FileBrowserComponent::warnAboutOverwriting,
+                              [this] (const juce::FileChooser& chooser)
+                              {
+                                  auto file = chooser.getResult();
+
+                                  if (file == juce::File())
+                                      return;
+
+                                  // Binary unless XML was asked for
+                                  if (! file.hasFileExtension (TapPattern::xmlFileExtension))
+                                      file = file.withFileExtension (TapPattern::binaryFileExtension);
+
+                                  auto pattern = getCurrentPattern();
+                                  pattern.name = file.getFileNameWithoutExtension();
+
+                                  auto result = pattern.saveToFile (file);
+
+                                  if (result.failed())
+                                  {
+                                      juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon, "Couldn't save the preset", result.getErrorMessage());
+                                      return;
+                                  }
+
+                                  addPreset (pattern);
+                                  presetBox.setSelectedItemIndex ((int) presets.size() - 1, juce::dontSendNotification);
+                              });
+}
+
+void MainComponent::loadPresetButtonClicked()
+{
+    fileChooser = std::make_unique<juce::FileChooser> ("Load presets...", juce::File(),
+                                                       juce::String ("*") + TapPattern::binaryFileExtension + ";*" + TapPattern::xmlFileExtension);
+
+    fileChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles
+                                | juce::FileBrowserComponent::canSelectMultipleItems,
+                              [this] (const juce::FileChooser& chooser)
+                              {
+                                  juce::StringArray errors;
+
+                                  for (auto& file : chooser.getResults())
+                                  {
+                                      TapPattern pattern;
+                                      auto result = pattern.loadFromFile (file);
+
+                                      if (result.wasOk())
+                                          addPreset (pattern);
+                                      else
+                                          errors.add (file.getFileName() + ": " + result.getErrorMessage());
+                                  }
+
+                                  if (! errors.isEmpty())
+                                      juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon, "Couldn't load every preset", errors.joinIntoString ("\n"));
+                              });
+}
+
+//==============================================================================
+void MainComponent::findLassoItemsInArea (juce::Array<int>& itemsFound, const juce::Rectangle<int>& area)
+{
+    tapGrid.findTapsIn (area.toFloat(), itemsFound);
+}
+
+juce::SelectedItemSet<int>& MainComponent::getLassoSelection()
+{
+    return selectedTaps;
+}
+
+void MainComponent::openButtonClicked()
+{
+    // Anything the format manager can read - launched asynchronously so the message loop keeps running while it's open
+    fileChooser = std::make_unique<juce::FileChooser> ("Select an audio file to play...", juce::File(), formatManager.getWildcardForAllFormats());
+
+    fileChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                              [this] (const juce::FileChooser& chooser)
+                              {
+                                  auto file = chooser.getResult();
+
+                                  if (file != juce::File()) // Empty if the user cancelled
+                                      openFile (file);
+                              });
+}
+
+void MainComponent::openFile (const juce::File& file)
+{
+    auto* reader = createReaderFor (file); // Create a reader to read the file - is new because it needs to be deleted when out of scope.
+
+    if (reader != nullptr) // If reader works - returns nullptr if file is not a format that AudioFormatManager can handle
+    {
+        std::unique_ptr<juce::AudioFormatReaderSource> newSource (new juce::AudioFormatReaderSource (reader, true)); // Make new source
+        // - declare as a unique ptr to avoid deleting previously allocated AudioFormatReaderSource on subsequent open file commands
+
+        // Connect reader to AudioTransportSource for use in getNextAudioBlock(). The transport wraps it in a
+        // BufferingAudioSource filled from readAheadThread, so reading and decoding never happen in the audio callback.
+        const int readAheadSamples = juce::roundToInt (readAheadSeconds * reader->sampleRate);
+        transportSource.setSource (newSource.get(), readAheadSamples, &readAheadThread, reader->sampleRate, (int) reader->numChannels);
+        playButton.setEnabled (true);
+        readerSource.reset (newSource.release()); // Safely release source resources as we have passed newSource's data on
+
+        peakCache.setFile (file); // Read back from disk if it's been opened before, otherwise worked out in the background
+    }
+}
+
+juce::AudioFormatReader* MainComponent::createReaderFor (const juce::File& file)
+{
+    // Uncompressed WAV and AIFF can be read straight out of a memory-mapped file, with no stream or copy in between
+    if (auto* format = formatManager.findFormatForFileExtension (file.getFileExtension()))
     {
-        const int bufferRemaining = delayBufferLength - writePosition; // This is the number of values left to move after the if above ^
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader (format->createMemoryMappedReader (file));
 
-        delayBuffer.copyFromWithRamp(channel, writePosition, bufferData + bufferRemaining, bufferRemaining, 1.0, 1.0);
-        delayBuffer.copyFromWithRamp(channel, 0, bufferData + bufferRemaining, bufferLength - bufferRemaining, 1.0, 1.0); // Wrap to start of buffer
+        if (mappedReader != nullptr && mappedReader->mapEntireFile())
+            return mappedReader.release();
     }
+
+    // Compressed formats (or a file too big to map) are decoded from a stream as usual
+    return formatManager.createReaderFor (file);
 }
 
-void MainComponent::getFromDelayBuffer(juce::AudioBuffer<float>& buffer, int channel, const int bufferLength, const int delayBufferLength, const float* bufferData, const float* delayBufferData)
+void MainComponent::playButtonClicked()
 {
-    //int delayTimeMS = 200;
-    //int delayTimeMS = delayTimesMS[0];
-    //const int readPosition = static_cast<int> (delayBufferLength + writePosition - (globalSampleRate * delayTimeMS / 1000)) % delayBufferLength;
+    transportSource.setPosition(0); // Reset the file position
+    transportSource.start(); // Start playback
+}
 
-    juce::Array<int> readPositions;
-    for (int i = 0; i < delayTimesMS.size(); i++)
+void MainComponent::liveInputButtonClicked()
+{
+    useLiveInput = liveInputButton.getToggleState();
+    mixFileButton.setEnabled (useLiveInput);
+    delayBoxOverlay.setShowsLiveInput (useLiveInput);
+
+    if (! useLiveInput)
+        return;
+
+    // Live playing needs a short buffer, so ask for the size nearest to liveBufferSize the device offers
+    if (auto* device = deviceManager.getCurrentAudioDevice())
     {
-        // Add read positions to array
-        readPositions.add(static_cast<int> (delayBufferLength + writePosition - (globalSampleRate * delayTimesMS[i] / 1000)) % delayBufferLength);
+        auto setup = deviceManager.getAudioDeviceSetup();
+        int nearest = setup.bufferSize;
 
-        // Add the delayed values back to the main buffer
-        if (delayBufferLength > bufferLength + readPositions[i])
-        {
-            buffer.addFromWithRamp(channel, 0, delayBufferData + readPositions[i], bufferLength, delayGains[i], delayGains[i]);
-        }
-        else
+        for (auto size : device->getAvailableBufferSizes())
+            if (std::abs (size - liveBufferSize) < std::abs (nearest - liveBufferSize))
+                nearest = size;
+
+        if (nearest != device->getCurrentBufferSizeSamples())
         {
-            const int bufferRemaining = delayBufferLength - readPositions[i];
-            buffer.addFromWithRamp(channel, 0, delayBufferData + readPositions[i], bufferRemaining, delayGains[i], delayGains[i]);
-            buffer.addFromWithRamp(channel, bufferRemaining, delayBufferData, bufferLength - bufferRemaining, delayGains[i], delayGains[i]);
+            setup.bufferSize = nearest;
+            auto error = deviceManager.setAudioDeviceSetup (setup, true);
+
+            if (error.isNotEmpty())
+                juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon, "Couldn't change the buffer size", error);
         }
     }
 }
 
-void MainComponent::feedbackDelay(int channel, const int bufferLength, const int delayBufferLength, float* dryBuffer)
+void MainComponent::settingsButtonClicked()
 {
-    if (delayBufferLength > bufferLength + writePosition)
+    // As many channels as the device has, not just a stereo pair
+    int maximumInputs = 2, maximumOutputs = 2;
+
+    if (auto* device = deviceManager.getCurrentAudioDevice())
     {
-        delayBuffer.addFromWithRamp(channel, writePosition, dryBuffer, bufferLength, 0.8, 0.8);
+        maximumInputs = juce::jmax (maximumInputs, device->getInputChannelNames().size());
+        maximumOutputs = juce::jmax (maximumOutputs, device->getOutputChannelNames().size());
     }
-    else
+
+    auto* selector = new juce::AudioDeviceSelectorComponent (deviceManager, 0, maximumInputs, 0, maximumOutputs, false, false, true, false);
+    selector->setSize (500, 400);
+
+    juce::DialogWindow::LaunchOptions options;
+    options.content.setOwned (selector);
+    options.dialogTitle = "Audio settings";
+    options.dialogBackgroundColour = getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId);
+    options.useNativeTitleBar = true;
+    options.resizable = false;
+    options.launchAsync();
+}
+
+void MainComponent::updateLatencyLabel()
+{
+    auto* device = deviceManager.getCurrentAudioDevice();
+
+    if (device == nullptr)
     {
-        const int bufferRemaining = delayBufferLength - writePosition;
+        latencyLabel.setText ("No audio device", juce::dontSendNotification);
+        return;
+    }
 
-        delayBuffer.addFromWithRamp(channel, bufferRemaining, dryBuffer, bufferRemaining, 0.8, 0.8);
-        delayBuffer.addFromWithRamp(channel, 0, dryBuffer, bufferLength - bufferRemaining, 0.8, 0.8);
+    // The engine itself adds no latency, so the round trip is the driver's figures plus a buffer each way
+    const int bufferSize = device->getCurrentBufferSizeSamples();
+    const int roundTrip = device->getInputLatencyInSamples() + device->getOutputLatencyInSamples() + 2 * bufferSize;
+    const double sampleRate = device->getCurrentSampleRate();
+
+    latencyLabel.setText ("Round trip " + juce::String (roundTrip * 1000.0 / sampleRate, 1) + " ms ("
+                            + juce::String (roundTrip) + " samples) - " + juce::String (bufferSize) + " sample buffer at "
+                            + juce::String (sampleRate / 1000.0, 1) + " kHz",
+                          juce::dontSendNotification);
+}
+
+void MainComponent::csvButtonClicked()
+{
+    if (! csvButton.getToggleState())
+    {
+        profiler.stopCSV();
+        return;
     }
-}
\ No newline at end of file
+
+    // The toggle stays on while the chooser's open, and goes back off if no log gets started
+    fileChooser = std::make_unique<juce::FileChooser> ("Save callback timings as...", juce::File(), "*.csv");
+
+    fileChooser->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                | juce::FileBrowserComponent::warnAboutOverwriting,
+                              [this] (const juce::FileChooser& chooser)
+                              {
+                                  auto file = chooser.getResult();
+
+                                  if (file != juce::File())
+                                  {
+                                      auto result = profiler.startCSV (file);
+
+                                      if (result.wasOk())
+                                          return;
+
+                                      juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon, "Couldn't log timings", result.getErrorMessage());
+                                  }
+
+                                  csvButton.setToggleState (false, juce::dontSendNotification);
+                              });
+}
+
+void MainComponent::sliderValueChanged(juce::Slider* slider)
+{
+    // The feedback amount goes out with the taps, so the two always change together
+    if (slider == &feedbackSlider)
+        tapsChanged();
+
+    if (slider == &modulationRateSlider || slider == &modulationDepthSlider)
+        delayEngine.setModulation ((float) modulationRateSlider.getValue(), (float) modulationDepthSlider.getValue());
+}
+
+void MainComponent::interpolationChanged()
+{
+    delayEngine.setInterpolation ((TapTable::Interpolation) (interpolationBox.getSelectedId() - 1));
+
+    // The taps are split up for it when they're compiled, so everything needs compiling again
+    compilePresets();
+    publishTaps();
+}
+
+void MainComponent::publishTaps()
+{
+    delayEngine.setTaps (delayTimesMS, delayGains, (float) feedbackSlider.getValue());
+}
+
+void MainComponent::scheduleTaps (juce::Time eventTime)
+{
+    // Mouse events are stamped with the wall clock, which the engine doesn't know about
+    const auto millisecondsAgo = (double) juce::jmax ((juce::int64) 0, (juce::Time::getCurrentTime() - eventTime).inMilliseconds());
+    const auto sampleTime = delayEngine.getSampleTimeFor (juce::Time::getMillisecondCounterHiRes() - millisecondsAgo);
+
+    if (! delayEngine.scheduleTaps (delayEngine.createTapTable (delayTimesMS, delayGains, (float) feedbackSlider.getValue()), sampleTime))
+        publishTaps(); // Too many waiting - just jump straight to where the taps are now
+}
+
+void MainComponent::handleAsyncUpdate()
+{
+    if (presetsNeedCompiling.exchange (false))
+        compilePresets();
+
+    if (tapsNeedRepublishing.exchange (false))
+        publishTaps();
+
+    delayBoxOverlay.setSampleRate (delayEngine.getSampleRate());
+    updateLatencyLabel();
+}
+
+void MainComponent::timerCallback()
+{
+    // An old line can run to hundreds of MB with many channels at high rates, so it shouldn't wait for the next edit
+    delayEngine.collectGarbage();
+}
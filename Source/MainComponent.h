@@ -2,6 +2,13 @@
 
 #include <JuceHeader.h>
 #include <iostream>
+#include "Engine/DelayEngine.h"
+#include "Engine/RealtimeSafety.h"
+#include "TapGrid.h"
+#include "LoadMeter.h"
+#include "TapPattern.h"
+#include "PeakCache.h"
+#include "DelayBoxOverlay.h"
 
 //==============================================================================
 /*
@@ -9,7 +16,10 @@
     your controls and content.
 */
 class MainComponent  : public juce::AudioAppComponent,
-                       public juce::Slider::Listener
+                       public juce::Slider::Listener,
+                       private juce::AsyncUpdater,
+                       private juce::Timer,
+                       private juce::LassoSource<int>
 {
 public:
     //==============================================================================
@@ -26,13 +36,11 @@ public:
     void resized() override;
 
     void mouseDown (const juce::MouseEvent& ev) override;
-    
-    void sliderValueChanged (juce::Slider* volumeSlider) override;
-
-    void fillDelayBuffer(int channel, const int bufferLength, const int delayBufferLength, const float* bufferData, const float* delayBufferData);
-    void getFromDelayBuffer(juce::AudioBuffer<float>& buffer, int channel, const int bufferLength, const int delayBufferLength, const float* bufferData, const float* delayBufferData);
+    void mouseDrag (const juce::MouseEvent& ev) override;
+    void mouseUp (const juce::MouseEvent& ev) override;
+    bool keyPressed (const juce::KeyPress& key) override;
 
-    void feedbackDelay(int channel, const int bufferLength, const int delayBufferLength, float* dryBuffer);
+    void sliderValueChanged (juce::Slider* slider) override;
 
 private:
     //==============================================================================
@@ -48,24 +56,146 @@ private:
     juce::TextButton playButton;  // For playing the audio file
     
     juce::Slider volumeSlider; // For controlling output level
+    juce::Slider feedbackSlider; // How much of the drawn taps gets fed back into the delay line
+
+    // Taps can sit between samples, and wobble about on an LFO
+    juce::ComboBox interpolationBox;
+    juce::Slider modulationRateSlider, modulationDepthSlider;
+    void interpolationChanged();
 
     // Button clicks
     void undoButtonClicked();
     void openButtonClicked();
+    void openFile (const juce::File& file);
+    juce::AudioFormatReader* createReaderFor (const juce::File& file);
     void playButtonClicked();
+    void csvButtonClicked();
+    void liveInputButtonClicked();
+    void openAudioChannels (bool inputAllowed); // Every channel the device has
+    void settingsButtonClicked();
+    void updateLatencyLabel();
+    void mixFileInto (const juce::AudioSourceChannelInfo& bufferToFill); // Audio thread
+    void savePresetButtonClicked();
+    void loadPresetButtonClicked();
+
+    // Every change to the taps goes through these, so the arrays and the grid always agree.
+    // Removing swaps the last tap into the gap, so only two taps ever change index.
+    void addTap (juce::Point<float> position);
+    void removeTap (int index);
+    void moveTap (int index, juce::Point<float> newPosition);
+    void tapsChanged(); // Call after a batch of edits
+
+    juce::Rectangle<float> getTapBounds (juce::Point<float> position) const; // Where a tap's circle is drawn
+    void redrawTaps (juce::Rectangle<float> area); // Redraws the cached taps in an area and repaints it
+    void rebuildTapLayer();
+
+    float getTimeMSFor (juce::Point<float> position) const;  // Where a tap sits in the box sets its delay...
+    float getGainFor (juce::Point<float> position) const;  // ...and its gain
+
+    // An undoable edit: some taps taken away and some put in, found again by position
+    struct TapEditAction;
+    void performTapEdit (const juce::Array<juce::Point<float>>& removed, const juce::Array<juce::Point<float>>& added, bool alreadyDone = false);
+
+    void deleteSelectedTaps();
+
+    // Presets - loading one replaces the drawing (and clears the undo history, like opening a document)
+    TapPattern getCurrentPattern() const;
+    void setPattern (const TapPattern& pattern);
+    void addPreset (const TapPattern& pattern);
+    void selectPreset (int index);
+    void compilePresets(); // Remakes every preset's table after the sample rate changes
+    juce::Point<float> getPositionFor (float timeMS, float gain) const;
+
+    // LassoSource
+    void findLassoItemsInArea (juce::Array<int>& itemsFound, const juce::Rectangle<int>& area) override;
+    juce::SelectedItemSet<int>& getLassoSelection() override;
+
+    void publishTaps(); // Hands a snapshot of the current taps to the audio thread
+    void scheduleTaps (juce::Time eventTime); // Likewise, but to be heard at the sample matching when eventTime happened
+    void handleAsyncUpdate() override; // Republishes the taps and the latency when the device restarts
+    void timerCallback() override; // Frees whatever the audio thread has finished with
 
     juce::AudioFormatManager formatManager;
+    std::unique_ptr<juce::FileChooser> fileChooser; // Kept alive while it's open, as it doesn't block
+
+    // Decodes the file ahead of playback, so the audio callback only ever copies from memory.
+    // Declared before the sources so it outlives the buffer the transport reads through.
+    juce::TimeSliceThread readAheadThread { "Audio file read-ahead" };
+    double readAheadSeconds = 2.0; // How much of the file is kept decoded ahead of the playhead
+
     std::unique_ptr<juce::AudioFormatReaderSource> readerSource; // To read from AudioFormatReader
     juce::AudioTransportSource transportSource; // Basically a positionable audio source with extra features for usability 
 
-    // Circular buffer
-    juce::AudioBuffer<float> delayBuffer;
-    int writePosition{ 0 };
-    int globalSampleRate{ 44100 }; 
-    const float maximumDelayTimeS = 5.0f;
-
-    juce::Array<int> delayTimesMS;
+    // Times every audio callback - the meter reads it back on the message thread
+    CallbackProfiler profiler;
+    LoadMeter loadMeter { profiler };
+    juce::ToggleButton csvButton { "Log timings to CSV" };
+
+    // Live mode delays whatever comes into the device, optionally with the file mixed in
+    juce::ToggleButton liveInputButton { "Live input" };
+    juce::ToggleButton mixFileButton { "Mix file" };
+    juce::TextButton settingsButton { "Audio settings" };
+    juce::Label latencyLabel;
+    std::atomic<bool> useLiveInput { false }, mixFileWithInput { false };
+    std::atomic<bool> tapsNeedRepublishing { false }; // Set when the sample rate changes
+    std::atomic<bool> presetsNeedCompiling { false }; // Set when the sample rate changes
+    juce::AudioBuffer<float> fileBuffer; // Where the file is read to before it's mixed with the input
+    static constexpr int liveBufferSize = 64; // What live mode asks the device for, if it can do it
+    static constexpr int garbageCollectionHz = 10;
+
+    juce::SharedResourcePointer<AudioWorkerPool> workerPool; // Shared with any other engines in the process
+    DelayEngine delayEngine;
+    const float maximumDelayTimeS = DelayEngine::maximumDelayTimeS;
+
+    // These are only ever touched on the message thread - the audio thread reads the table the engine publishes instead
+    juce::Array<float> delayTimesMS; // Not rounded to anything - the engine reads between samples
     juce::Array<float> delayGains;
 
+    // What the taps are reading, drawn over the box: the file's waveform from its peak summary (made in the
+    // background, and kept on disk for next time), and the levels the audio thread sends back for live input and the tap meters
+    PeakCache peakCache { formatManager };
+    LevelFifo levelFifo;
+    DelayBoxOverlay delayBoxOverlay { peakCache, levelFifo, transportSource, delayTimesMS, delayGains, maximumDelayTimeS };
+
+    // Each preset is compiled into a tap table as it's loaded, so switching to it is a pointer swap and a crossfade
+    struct Preset
+    {
+        TapPattern pattern;
+        TapTable::Ptr table;
+    };
+
+    std::vector<Preset> presets;
+    juce::ComboBox presetBox;
+    juce::TextButton savePresetButton { "Save preset" };
+    juce::TextButton loadPresetButton { "Load presets" };
+
+    static constexpr float tapSize = 10.0f;
+    TapGrid tapGrid { tapSize };  // Index over mousePosArray for hit-testing
+
+    // Indices into the tap arrays. Tells us exactly which taps changed, so only they get redrawn.
+    struct TapSelection  : public juce::SelectedItemSet<int>
+    {
+        std::function<void (int, bool)> onChange;
+
+        void itemSelected (int index) override     { if (onChange != nullptr) onChange (index, true); }
+        void itemDeselected (int index) override   { if (onChange != nullptr) onChange (index, false); }
+    };
+
+    TapSelection selectedTaps;
+    std::vector<bool> tapIsSelected; // The same thing by tap, since SelectedItemSet::isSelected() is a linear search
+
+    // The taps are drawn into this as they change, and paint() just copies the part being repainted.
+    // Anything that moves on its own (playhead, meters) belongs in a child component on top, so it
+    // never makes the taps redraw.
+    juce::Image tapLayer;
+    juce::LassoComponent<int> lasso;
+    juce::UndoManager undoManager;
+
+    // What the current mouse gesture is doing
+    int pressedTap = -1;
+    bool isLassoing = false;
+    bool selectOnMouseUp = false;
+    juce::Array<juce::Point<float>> dragStartPositions; // Of the selected taps, in selection order
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
 };
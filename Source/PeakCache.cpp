@@ -0,0 +1,296 @@
+#include "PeakCache.h"
+
+namespace
+{
+    constexpr int cacheMagic = 0x6b506444; // "DdPk" when written little-endian
+    constexpr int cacheVersion = 1;
+
+    juce::int8 toPeakValue (float sample) noexcept
+    {
+        return (juce::int8) juce::jlimit (-127, 127, juce::roundToInt (sample * 127.0f));
+    }
+}
+
+//==============================================================================
+PeakCache::PeakCache (juce::AudioFormatManager& formatManagerToUse)
+    : formatManager (formatManagerToUse)
+{
+    int levelSamplesPerPeak = samplesPerPeak;
+
+    for (auto& level : levels)
+    {
+        level.samplesPerPeak = levelSamplesPerPeak;
+        levelSamplesPerPeak *= levelRatio;
+    }
+
+    thread.startThread (1); // Well below the read-ahead, which playback depends on
+}
+
+PeakCache::~PeakCache()
+{
+    thread.removeTimeSliceClient (this);
+    thread.stopThread (2000);
+}
+
+//==============================================================================
+void PeakCache::setFile (const juce::File& file)
+{
+    clear();
+
+    reader.reset (formatManager.createReaderFor (file));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+    {
+        reader.reset();
+        return;
+    }
+
+    lengthInSamples = reader->lengthInSamples;
+    sampleRate = reader->sampleRate;
+
+    // Everything is allocated up front, so the thread only ever writes into it
+    for (auto& level : levels)
+        level.peaks.assign ((size_t) ((lengthInSamples + level.samplesPerPeak - 1) / level.samplesPerPeak), Peak { 0, 0 });
+
+    chunk.setSize ((int) reader->numChannels, chunkSize);
+
+    // Anything about the file that changes means a different summary
+    const auto key = file.getFullPathName() + "|" + juce::String (file.getSize())
+                   + "|" + juce::String (file.getLastModificationTime().toMilliseconds());
+    cacheFile = getCacheDirectory().getChildFile (juce::String::toHexString (key.hashCode64()) + ".ddpeaks");
+
+    thread.addTimeSliceClient (this);
+}
+
+void PeakCache::clear()
+{
+    // Waits for the thread to finish whatever it's in the middle of
+    thread.removeTimeSliceClient (this);
+
+    reader.reset();
+    lengthInSamples = 0;
+    sampleRate = 0.0;
+    numSamplesDone = 0;
+    triedCacheFile = false;
+
+    for (auto& level : levels)
+        level.peaks.clear();
+
+    sendChangeMessage();
+}
+
+//==============================================================================
+int PeakCache::useTimeSlice()
+{
+    if (! triedCacheFile)
+    {
+        triedCacheFile = true;
+
+        if (readCacheFile())
+        {
+            sendChangeMessage();
+            return -1;
+        }
+    }
+
+    const auto startSample = numSamplesDone.load();
+    const int numSamples = (int) juce::jmin ((juce::int64) chunkSize, lengthInSamples - startSample);
+
+    reader->read (&chunk, 0, numSamples, startSample, true, true);
+    summariseChunk (chunk, numSamples, startSample);
+    numSamplesDone.store (startSample + numSamples);
+
+    if (isFullyLoaded())
+    {
+        writeCacheFile();
+        sendChangeMessage();
+        return -1;
+    }
+
+    return 0;
+}
+
+void PeakCache::summariseChunk (const juce::AudioBuffer<float>& source, int numSamples, juce::int64 startSample)
+{
+    auto& peaks = levels[0].peaks;
+
+    for (int offset = 0; offset < numSamples; offset += samplesPerPeak)
+    {
+        const int num = juce::jmin (samplesPerPeak, numSamples - offset);
+        auto range = source.findMinMax (0, offset, num);
+
+        for (int channel = 1; channel < source.getNumChannels(); ++channel)
+            range = range.getUnionWith (source.findMinMax (channel, offset, num));
+
+        peaks[(size_t) ((startSample + offset) / samplesPerPeak)] = { toPeakValue (range.getStart()), toPeakValue (range.getEnd()) };
+    }
+
+    updateLevelsAbove (startSample, startSample + numSamples);
+}
+
+void PeakCache::updateLevelsAbove (juce::int64 startSample, juce::int64 endSample)
+{
+    // Each peak is worked out again from all of its finished children, so one that spans several chunks just grows
+    for (int i = 1; i < numLevels; ++i)
+    {
+        const auto& children = levels[(size_t) i - 1];
+        auto& level = levels[(size_t) i];
+
+        const auto numChildrenDone = (endSample + children.samplesPerPeak - 1) / children.samplesPerPeak;
+        const auto first = startSample / level.samplesPerPeak;
+        const auto last = (endSample - 1) / level.samplesPerPeak;
+
+        for (auto index = first; index <= last; ++index)
+        {
+            const auto firstChild = index * levelRatio;
+            const auto endChild = juce::jmin (firstChild + levelRatio, numChildrenDone);
+
+            auto peak = children.peaks[(size_t) firstChild];
+
+            for (auto child = firstChild + 1; child < endChild; ++child)
+            {
+                peak.minimum = juce::jmin (peak.minimum, children.peaks[(size_t) child].minimum);
+                peak.maximum = juce::jmax (peak.maximum, children.peaks[(size_t) child].maximum);
+            }
+
+            level.peaks[(size_t) index] = peak;
+        }
+    }
+}
+
+juce::int64 PeakCache::getNumPeaksDone (const Level& level) const noexcept
+{
+    const auto done = numSamplesDone.load();
+
+    // The last peak is usually short, so it's only finished when the whole file is
+    return done >= lengthInSamples ? (juce::int64) level.peaks.size() : done / level.samplesPerPeak;
+}
+
+//==============================================================================
+void PeakCache::getPeaks (double startSecond, double endSecond, juce::Range<float>* peaks, int numPeaks) const
+{
+    if (numPeaks <= 0)
+        return;
+
+    if (! hasFile() || endSecond <= startSecond)
+    {
+        std::fill (peaks, peaks + numPeaks, juce::Range<float>());
+        return;
+    }
+
+    // The coarsest level with at least one peak for every slice
+    const double samplesPerSlice = (endSecond - startSecond) * sampleRate / numPeaks;
+    const Level* level = &levels[0];
+
+    for (auto& l : levels)
+        if (l.samplesPerPeak <= samplesPerSlice)
+            level = &l;
+
+    const auto numDone = getNumPeaksDone (*level);
+
+    for (int i = 0; i < numPeaks; ++i)
+    {
+        const double sliceStart = startSecond * sampleRate + i * samplesPerSlice;
+        const auto first = juce::jmax ((juce::int64) 0, (juce::int64) std::floor (sliceStart / level->samplesPerPeak));
+        const auto end = juce::jmin (numDone, (juce::int64) std::ceil ((sliceStart + samplesPerSlice) / level->samplesPerPeak));
+
+        if (first >= end)
+        {
+            peaks[i] = {};
+            continue;
+        }
+
+        int minimum = 127, maximum = -127;
+
+        for (auto index = first; index < end; ++index)
+        {
+            minimum = juce::jmin (minimum, (int) level->peaks[(size_t) index].minimum);
+            maximum = juce::jmax (maximum, (int) level->peaks[(size_t) index].maximum);
+        }
+
+        peaks[i] = { minimum / 127.0f, maximum / 127.0f };
+    }
+}
+
+//==============================================================================
+juce::File PeakCache::getCacheDirectory()
+{
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+             .getChildFile ("Draw Delay").getChildFile ("Peak cache");
+}
+
+bool PeakCache::readCacheFile()
+{
+    juce::FileInputStream in (cacheFile);
+
+    if (! in.openedOk() || in.readInt() != cacheMagic || in.readCompressedInt() != cacheVersion)
+        return false;
+
+    // Only level 0 is stored - the rest take no time to work out again
+    auto& level = levels[0];
+
+    if (in.readInt64() != lengthInSamples || in.readDouble() != sampleRate
+         || in.readInt() != samplesPerPeak || in.readInt64() != (juce::int64) level.peaks.size())
+        return false;
+
+    const auto numBytes = level.peaks.size() * sizeof (Peak);
+
+    if (in.read (level.peaks.data(), (int) numBytes) != (int) numBytes)
+        return false;
+
+    // Nothing can be read on the message thread until numSamplesDone moves, so every level is filled in first
+    updateLevelsAbove (0, lengthInSamples);
+    numSamplesDone.store (lengthInSamples);
+
+    // Touched, so the files pruned first are the ones that haven't been opened for longest
+    cacheFile.setLastModificationTime (juce::Time::getCurrentTime());
+    return true;
+}
+
+void PeakCache::writeCacheFile() const
+{
+    if (! getCacheDirectory().createDirectory())
+        return;
+
+    // Written to a temporary file and moved into place, so a summary cut short is never read back
+    juce::TemporaryFile temporary (cacheFile);
+
+    {
+        juce::FileOutputStream out (temporary.getFile());
+
+        if (! out.openedOk())
+            return;
+
+        const auto& level = levels[0];
+
+        out.writeInt (cacheMagic);
+        out.writeCompressedInt (cacheVersion);
+        out.writeInt64 (lengthInSamples);
+        out.writeDouble (sampleRate);
+        out.writeInt (samplesPerPeak);
+        out.writeInt64 ((juce::int64) level.peaks.size());
+        out.write (level.peaks.data(), level.peaks.size() * sizeof (Peak));
+
+        if (out.getStatus().failed())
+            return;
+    }
+
+    if (temporary.overwriteTargetFileWithTemporary())
+        pruneCacheDirectory();
+}
+
+void PeakCache::pruneCacheDirectory()
+{
+    auto files = getCacheDirectory().findChildFiles (juce::File::findFiles, false, "*.ddpeaks");
+
+    if (files.size() <= maximumCacheFiles)
+        return;
+
+    std::sort (files.begin(), files.end(), [] (const juce::File& a, const juce::File& b)
+    {
+        return a.getLastModificationTime() > b.getLastModificationTime();
+    });
+
+    for (int i = maximumCacheFiles; i < files.size(); ++i)
+        files.getReference (i).deleteFile();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+//==============================================================================
+/*
+    A min/max summary of an audio file at several resolutions, for drawing its
+    waveform at any zoom without going back to the file - along the lines of
+    juce::AudioThumbnail and AudioThumbnailCache, but with every resolution kept
+    and a copy on disk.
+
+    Level 0 has a peak (all the channels together) per samplesPerPeak samples, and
+    each level after it has one per levelRatio of the level before, so a waveform
+    of any width never reads more than a few peaks a pixel.
+
+    setFile() starts building on a background thread, reading the file a chunk at
+    a time; peaks can be drawn as soon as they're done, so the waveform fills in
+    while it loads. The finished summary is written to the cache directory, keyed
+    on the file's path, size and modification time, and opening the same file again
+    just reads that back. A change message goes out when the peaks are all there.
+*/
+class PeakCache  : public juce::ChangeBroadcaster,
+                   private juce::TimeSliceClient
+{
+public:
+    explicit PeakCache (juce::AudioFormatManager& formatManagerToUse);
+    ~PeakCache() override;
+
+    //==============================================================================
+    /** Forgets the last file and starts summarising this one. */
+    void setFile (const juce::File& file);
+    void clear();
+
+    bool hasFile() const noexcept                   { return lengthInSamples > 0; }
+    bool isFullyLoaded() const noexcept             { return numSamplesDone.load() >= lengthInSamples; }
+    double getLengthInSeconds() const noexcept      { return sampleRate > 0.0 ? (double) lengthInSamples / sampleRate : 0.0; }
+
+    /** Fills numPeaks min/max ranges, one for each equal slice of the time between startSecond and endSecond.
+        Any slice outside the file, or not read yet, comes back empty.
+    */
+    void getPeaks (double startSecond, double endSecond, juce::Range<float>* peaks, int numPeaks) const;
+
+    /** Where the summaries are kept - anything but the newest maximumCacheFiles is deleted. */
+    static juce::File getCacheDirectory();
+
+    static constexpr int samplesPerPeak = 64;
+    static constexpr int levelRatio = 4;
+    static constexpr int numLevels = 7;          // The coarsest has a peak per 262144 samples
+    static constexpr int maximumCacheFiles = 100;
+
+private:
+    //==============================================================================
+    // Stored as 8 bits, the same as AudioThumbnail - plenty for drawing
+    struct Peak
+    {
+        juce::int8 minimum, maximum;
+    };
+
+    struct Level
+    {
+        std::vector<Peak> peaks;
+        int samplesPerPeak = 0;
+    };
+
+    int useTimeSlice() override;
+
+    bool readCacheFile();
+    void writeCacheFile() const;
+    static void pruneCacheDirectory();
+
+    void summariseChunk (const juce::AudioBuffer<float>& chunk, int numSamples, juce::int64 startSample);
+    void updateLevelsAbove (juce::int64 startSample, juce::int64 endSample);
+
+    // How many of a level's peaks are finished, and so safe to read on the message thread
+    juce::int64 getNumPeaksDone (const Level& level) const noexcept;
+
+    //==============================================================================
+    juce::AudioFormatManager& formatManager;
+    juce::TimeSliceThread thread { "Peak cache" };
+
+    // Set up by setFile() before the thread gets going, then only read
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    juce::File cacheFile;
+    juce::int64 lengthInSamples = 0;
+    double sampleRate = 0.0;
+
+    // The thread fills the peaks in order, and moves this on once they're finished
+    std::array<Level, numLevels> levels;
+    std::atomic<juce::int64> numSamplesDone { 0 };
+    bool triedCacheFile = false;
+    juce::AudioBuffer<float> chunk;
+
+    static constexpr int chunkSize = 65536;      // A whole number of peaks at every level but the last
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PeakCache)
+};
@@ -0,0 +1,187 @@
+#include "DrawDelayProcessor.h"
+
+//==============================================================================
+DrawDelayProcessor::DrawDelayProcessor()
+    : juce::AudioProcessor (BusesProperties().withInput ("Input", juce::AudioChannelSet::stereo(), true)
+                                             .withOutput ("Output", juce::AudioChannelSet::stereo(), true))
+{
+    // Something to hear before a pattern is loaded - the same taps the batch renderer's usage shows
+    pattern.name = "Default";
+    pattern.delayTimesMS = { 250.0f, 500.0f, 750.0f };
+    pattern.delayGains = { 0.5f, 0.3f, 0.15f };
+
+    addParameter (feedback = new juce::AudioParameterFloat ("feedback", "Feedback", 0.0f, TapTable::maximumFeedback, 0.0f));
+    addParameter (interpolation = new juce::AudioParameterChoice ("interpolation", "Interpolation",
+                                                                  { "None", "Linear", "Cubic" }, (int) TapTable::Interpolation::linear));
+
+    juce::NormalisableRange<float> rateRange (0.05f, 10.0f);
+    rateRange.setSkewForCentre (1.0f);
+
+    addParameter (modulationRate = new juce::AudioParameterFloat ("modulationRate", "Wobble rate", rateRange, 0.5f));
+    addParameter (modulationDepth = new juce::AudioParameterFloat ("modulationDepth", "Wobble depth", 0.0f, DelayEngine::maximumModulationDepthMS, 0.0f));
+    addParameter (bypass = new juce::AudioParameterBool ("bypass", "Bypass", false));
+
+    // Room for the deepest LFO up front, so its depth can be automated from the audio thread without the line ever growing there
+    delayEngine.setModulation (0.0f, DelayEngine::maximumModulationDepthMS);
+    delayEngine.setModulation (0.0f, 0.0f);
+
+    startTimerHz (republishCheckHz);
+}
+
+DrawDelayProcessor::~DrawDelayProcessor()
+{
+    stopTimer();
+}
+
+//==============================================================================
+void DrawDelayProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    const juce::ScopedLock sl (patternLock);
+
+    // Blocks bigger than this still work - the engine goes through them in pieces this size
+    delayEngine.prepare (sampleRate, maximumExpectedSamplesPerBlock, juce::jmax (1, getTotalNumOutputChannels()));
+
+    // The convolution stages are lined up so they add no latency, and nothing else does either
+    setLatencySamples (0);
+
+    // The tables are in samples, so they're made again for the new rate
+    publishTaps();
+}
+
+void DrawDelayProcessor::releaseResources()
+{
+    // The line and the convolver are kept - they're only as big as the taps need, and the host is
+    // likely to start playing again with the same ones
+}
+
+bool DrawDelayProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+    // Any number of channels, as long as it's the same in and out
+    const auto output = layouts.getMainOutputChannelSet();
+    return ! output.isDisabled() && output == layouts.getMainInputChannelSet();
+}
+
+//==============================================================================
+void DrawDelayProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi)
+{
+    // Some hosts bypass through the parameter rather than calling processBlockBypassed()
+    if (bypass->get())
+    {
+        processBlockBypassed (buffer, midi);
+        return;
+    }
+
+    for (int channel = getTotalNumInputChannels(); channel < getTotalNumOutputChannels(); ++channel)
+        buffer.clear (channel, 0, buffer.getNumSamples());
+
+    // Whatever was in the line when bypass started is long out of date, so it's heard from scratch
+    if (std::exchange (wasBypassed, false))
+        delayEngine.reset();
+
+    // Never deeper than the room made in the constructor, so this only ever sets a couple of atomics
+    delayEngine.setModulation (modulationRate->get(), modulationDepth->get());
+
+    delayEngine.process (buffer, 0, buffer.getNumSamples());
+}
+
+void DrawDelayProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    // With no latency to make up, the input just passes through - and the engine isn't run at all,
+    // which is most of the point of bypassing one instance out of hundreds
+    for (int channel = getTotalNumInputChannels(); channel < getTotalNumOutputChannels(); ++channel)
+        buffer.clear (channel, 0, buffer.getNumSamples());
+
+    wasBypassed = true;
+}
+
+double DrawDelayProcessor::getTailLengthSeconds() const
+{
+    const juce::ScopedLock sl (patternLock);
+    return DelayEngine::getTailLengthSeconds (pattern.delayTimesMS, feedback->get(), modulationDepth->get());
+}
+
+//==============================================================================
+juce::AudioProcessorEditor* DrawDelayProcessor::createEditor()
+{
+    // Just the parameters - the taps are drawn in the app and come in as a preset
+    return new juce::GenericAudioProcessorEditor (*this);
+}
+
+//==============================================================================
+void DrawDelayProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    juce::MemoryOutputStream out (destData, false);
+
+    getTapPattern().writeTo (out);
+    out.writeFloat (modulationRate->get());
+    out.writeFloat (modulationDepth->get());
+    out.writeCompressedInt (interpolation->getIndex());
+}
+
+void DrawDelayProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream in (data, (size_t) sizeInBytes, false);
+
+    TapPattern loaded;
+
+    if (loaded.readFrom (in).failed())
+        return;
+
+    // Anything after the pattern is optional, so a bare preset file's contents work as a state too
+    if (! in.isExhausted())
+    {
+        *modulationRate = in.readFloat();
+        *modulationDepth = in.readFloat();
+        *interpolation = in.readCompressedInt();
+    }
+
+    setTapPattern (loaded);
+}
+
+//==============================================================================
+void DrawDelayProcessor::setTapPattern (const TapPattern& newPattern)
+{
+    // Set before taking the lock - the host hears about it straight away, and might ask for the state while it does
+    *feedback = newPattern.feedback;
+
+    const juce::ScopedLock sl (patternLock);
+    pattern = newPattern;
+    publishTaps();
+}
+
+TapPattern DrawDelayProcessor::getTapPattern() const
+{
+    const juce::ScopedLock sl (patternLock);
+
+    auto copy = pattern;
+    copy.feedback = feedback->get();
+    return copy;
+}
+
+void DrawDelayProcessor::timerCallback()
+{
+    const juce::ScopedLock sl (patternLock);
+
+    if (feedback->get() != publishedFeedback || interpolation->getIndex() != publishedInterpolation)
+        publishTaps();
+
+    // Whatever the audio thread has let go of (an old line, say) is freed here rather than waiting for the next edit
+    delayEngine.collectGarbage();
+}
+
+void DrawDelayProcessor::publishTaps()
+{
+    // Always called with patternLock held, which keeps the engine to one editing thread at a time
+    publishedFeedback = feedback->get();
+    publishedInterpolation = interpolation->getIndex();
+
+    delayEngine.setInterpolation ((TapTable::Interpolation) publishedInterpolation);
+    delayEngine.setTaps (pattern.delayTimesMS, pattern.delayGains, publishedFeedback);
+}
+
+//==============================================================================
+// This creates new instances of the plugin
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new DrawDelayProcessor();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Engine/DelayEngine.h"
+#include "TapPattern.h"
+
+//==============================================================================
+/*
+    The delay engine as a plugin (VST3, and LV2 with JUCE 7), for hosts that run it
+    alongside everything else rather than letting it own the audio device.
+
+    There's no drawing here - the taps come from the saved state, or from a preset
+    drawn in the app and passed to setTapPattern(). Feedback, interpolation and the
+    LFO are parameters the host can automate, and bypass is the host's own.
+
+    It's built to be cheap to have hundreds of: the delay line only grows as long as
+    the taps need, the convolver is only made once a pattern is dense enough to use
+    it, and nothing runs on a worker pool. The engine adds no latency, and the tail
+    is however long the taps (and feedback) keep sounding.
+*/
+class DrawDelayProcessor  : public juce::AudioProcessor,
+                           private juce::Timer
+{
+public:
+    //==============================================================================
+    DrawDelayProcessor();
+    ~DrawDelayProcessor() override;
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override;
+    void processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override;
+
+    juce::AudioProcessorParameter* getBypassParameter() const override    { return bypass; }
+    double getTailLengthSeconds() const override;
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override                                 { return true; }
+
+    const juce::String getName() const override                     { return "Draw Delay"; }
+    bool acceptsMidi() const override                               { return false; }
+    bool producesMidi() const override                              { return false; }
+
+    int getNumPrograms() override                                   { return 1; }
+    int getCurrentProgram() override                                { return 0; }
+    void setCurrentProgram (int) override                           {}
+    const juce::String getProgramName (int) override                { return {}; }
+    void changeProgramName (int, const juce::String&) override      {}
+
+    /** The taps in the same binary format the app saves presets in, followed by the LFO and interpolation. */
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+    //==============================================================================
+    /** Replaces the taps, bringing the pattern's feedback amount with them. */
+    void setTapPattern (const TapPattern& newPattern);
+    TapPattern getTapPattern() const;
+
+    /** The size of the delay line this instance has grown to, in bytes. */
+    size_t getDelayLineSizeInBytes() const noexcept    { return delayEngine.getDelayLineSizeInBytes(); }
+
+private:
+    //==============================================================================
+    void timerCallback() override;
+    void publishTaps();
+
+    DelayEngine delayEngine;
+
+    // Only touched off the audio thread - a lock is fine here, since hosts can ask for the state from anywhere
+    juce::CriticalSection patternLock;
+    TapPattern pattern;
+
+    juce::AudioParameterFloat* feedback;
+    juce::AudioParameterChoice* interpolation;
+    juce::AudioParameterFloat* modulationRate;
+    juce::AudioParameterFloat* modulationDepth;
+    juce::AudioParameterBool* bypass;
+
+    // Feedback and interpolation are compiled into the tap table, which can't happen on the audio thread,
+    // so the timer notices when they've been automated and makes a new one
+    float publishedFeedback = 0.0f;
+    int publishedInterpolation = -1;
+
+    bool wasBypassed = false; // Audio thread only
+
+    static constexpr int republishCheckHz = 30;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DrawDelayProcessor)
+};
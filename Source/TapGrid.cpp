@@ -0,0 +1,173 @@
+#include "TapGrid.h"
+
+//==============================================================================
+TapGrid::TapGrid (float size)
+    : cellSize (size)
+{
+    jassert (cellSize > 0.0f);
+}
+
+void TapGrid::clear()
+{
+    cells.clear();
+}
+
+//==============================================================================
+void TapGrid::add (int index, juce::Point<float> position)
+{
+    // The only lookup that makes a cell - the rest leave the map alone
+    cells[getCellKeyFor (position)].push_back ({ index, position });
+}
+
+void TapGrid::remove (int index, juce::Point<float> position)
+{
+    auto cell = findCellFor (position);
+
+    if (cell != cells.end())
+    {
+        auto& entries = cell->second;
+
+        for (auto entry = entries.begin(); entry != entries.end(); ++entry)
+        {
+            if (entry->index == index)
+            {
+                // Order within a cell doesn't matter, so swap with the last rather than shuffling everything down
+                *entry = entries.back();
+                entries.pop_back();
+
+                // Only occupied cells are kept, so a big rubber band can tell when it's quicker to go through the taps
+                if (entries.empty())
+                    cells.erase (cell);
+
+                return;
+            }
+        }
+    }
+
+    jassertfalse; // The grid and the arrays have got out of step
+}
+
+void TapGrid::move (int index, juce::Point<float> from, juce::Point<float> to)
+{
+    remove (index, from);
+    add (index, to);
+}
+
+void TapGrid::reindex (int oldIndex, int newIndex, juce::Point<float> position)
+{
+    auto cell = findCellFor (position);
+
+    if (cell != cells.end())
+    {
+        for (auto& entry : cell->second)
+        {
+            if (entry.index == oldIndex)
+            {
+                entry.index = newIndex;
+                return;
+            }
+        }
+    }
+
+    jassertfalse;
+}
+
+//==============================================================================
+int TapGrid::findTapAt (juce::Point<float> position, float radius) const
+{
+    int nearest = -1;
+    float nearestDistance = std::numeric_limits<float>::max();
+
+    forEachEntryIn ({ position.x - radius, position.y - radius, radius * 2.0f, radius * 2.0f }, [&] (const Entry& entry)
+    {
+        // The same square hit area the taps have always had
+        if (std::abs (entry.position.x - position.x) >= radius || std::abs (entry.position.y - position.y) >= radius)
+            return;
+
+        auto distance = entry.position.getDistanceSquaredFrom (position);
+
+        if (distance < nearestDistance)
+        {
+            nearest = entry.index;
+            nearestDistance = distance;
+        }
+    });
+
+    return nearest;
+}
+
+int TapGrid::findTapExactlyAt (juce::Point<float> position) const
+{
+    auto cell = findCellFor (position);
+
+    if (cell != cells.end())
+        for (auto& entry : cell->second)
+            if (entry.position == position)
+                return entry.index;
+
+    return -1;
+}
+
+void TapGrid::findTapsIn (juce::Rectangle<float> area, juce::Array<int>& results) const
+{
+    forEachEntryIn (area, [&] (const Entry& entry)
+    {
+        if (area.contains (entry.position))
+            results.add (entry.index);
+    });
+}
+
+//==============================================================================
+TapGrid::CellKey TapGrid::getCellKey (int cellX, int cellY) const noexcept
+{
+    return ((CellKey) cellX << 32) | (CellKey) (juce::uint32) cellY;
+}
+
+int TapGrid::getCellCoordinate (float position) const noexcept
+{
+    return (int) std::floor (position / cellSize);
+}
+
+TapGrid::CellKey TapGrid::getCellKeyFor (juce::Point<float> position) const noexcept
+{
+    return getCellKey (getCellCoordinate (position.x), getCellCoordinate (position.y));
+}
+
+TapGrid::Cells::iterator TapGrid::findCellFor (juce::Point<float> position)
+{
+    return cells.find (getCellKeyFor (position));
+}
+
+TapGrid::Cells::const_iterator TapGrid::findCellFor (juce::Point<float> position) const
+{
+    return cells.find (getCellKeyFor (position));
+}
+
+template <typename Callback>
+void TapGrid::forEachEntryIn (juce::Rectangle<float> area, Callback&& callback) const
+{
+    const int firstX = getCellCoordinate (area.getX()), lastX = getCellCoordinate (area.getRight());
+    const int firstY = getCellCoordinate (area.getY()), lastY = getCellCoordinate (area.getBottom());
+
+    // A huge rubber band covers more cells than there are taps - then it's quicker to go through the taps
+    if ((juce::int64) (lastX - firstX + 1) * (lastY - firstY + 1) > (juce::int64) cells.size())
+    {
+        for (auto& cell : cells)
+            for (auto& entry : cell.second)
+                callback (entry);
+
+        return;
+    }
+
+    for (int x = firstX; x <= lastX; ++x)
+    {
+        for (int y = firstY; y <= lastY; ++y)
+        {
+            auto cell = cells.find (getCellKey (x, y));
+
+            if (cell != cells.end())
+                for (auto& entry : cell->second)
+                    callback (entry);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <unordered_map>
+#include <vector>
+
+//==============================================================================
+/*
+    A uniform grid over the drawn tap positions, so finding the tap under the mouse
+    (or every tap inside a rubber band) only looks at the few cells nearby instead of
+    scanning the whole pattern.
+
+    Taps are referred to by their index in MainComponent's arrays. The grid is kept
+    up to date one tap at a time as they're added, moved, removed or re-indexed, so
+    an edit never has to rebuild it.
+*/
+class TapGrid
+{
+public:
+    //==============================================================================
+    /** cellSize should be about the size of a tap, so a hit-test only touches a handful of cells. */
+    explicit TapGrid (float cellSize);
+
+    void clear();
+
+    void add (int index, juce::Point<float> position);
+    void remove (int index, juce::Point<float> position);
+    void move (int index, juce::Point<float> from, juce::Point<float> to);
+
+    /** The tap at position has moved from one index to another (e.g. swapped into a removed tap's place). */
+    void reindex (int oldIndex, int newIndex, juce::Point<float> position);
+
+    /** Returns the tap nearest to position whose hit square (radius either side of it) contains it, or -1. */
+    int findTapAt (juce::Point<float> position, float radius) const;
+
+    /** Returns a tap at exactly this position, or -1. */
+    int findTapExactlyAt (juce::Point<float> position) const;
+
+    /** Adds every tap inside area to results. */
+    void findTapsIn (juce::Rectangle<float> area, juce::Array<int>& results) const;
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        int index;
+        juce::Point<float> position;
+    };
+
+    using CellKey = juce::int64;
+    using Cells = std::unordered_map<CellKey, std::vector<Entry>>;
+
+    CellKey getCellKey (int cellX, int cellY) const noexcept;
+    CellKey getCellKeyFor (juce::Point<float> position) const noexcept;
+    int getCellCoordinate (float position) const noexcept;
+    Cells::iterator findCellFor (juce::Point<float> position);
+    Cells::const_iterator findCellFor (juce::Point<float> position) const;
+
+    template <typename Callback>
+    void forEachEntryIn (juce::Rectangle<float> area, Callback&& callback) const;
+
+    const float cellSize;
+    Cells cells; // Only cells with taps in - an emptied one is erased
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TapGrid)
+};
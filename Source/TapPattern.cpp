@@ -0,0 +1,169 @@
+#include "TapPattern.h"
+#include "Engine/DelayEngine.h"
+
+namespace TapPatternIDs
+{
+    static const juce::Identifier pattern ("TapPattern");
+    static const juce::Identifier tap ("Tap");
+    static const juce::Identifier name ("name");
+    static const juce::Identifier feedback ("feedback");
+    static const juce::Identifier timeMS ("timeMS");
+    static const juce::Identifier gain ("gain");
+}
+
+//==============================================================================
+void TapPattern::writeTo (juce::OutputStream& out) const
+{
+    jassert (delayTimesMS.size() == delayGains.size());
+
+    out.writeInt (magic);
+    out.writeCompressedInt (version);
+    out.writeString (name);
+    out.writeFloat (feedback);
+    out.writeCompressedInt (size());
+
+    for (int i = 0; i < size(); ++i)
+    {
+        out.writeFloat (delayTimesMS[i]);
+        out.writeFloat (delayGains[i]);
+    }
+}
+
+juce::Result TapPattern::readFrom (juce::InputStream& in)
+{
+    if (in.readInt() != magic)
+        return juce::Result::fail ("Not a tap preset");
+
+    const int fileVersion = in.readCompressedInt();
+
+    if (fileVersion > version)
+        return juce::Result::fail ("This preset was saved by a newer version");
+
+    TapPattern loaded;
+    loaded.name = in.readString();
+    loaded.feedback = in.readFloat();
+
+    const int numTaps = in.readCompressedInt();
+
+    if (numTaps < 0)
+        return juce::Result::fail ("The preset is damaged");
+
+    for (int i = 0; i < numTaps && ! in.isExhausted(); ++i)
+    {
+        loaded.delayTimesMS.add (fileVersion < 2 ? (float) in.readCompressedInt() : in.readFloat());
+        loaded.delayGains.add (in.readFloat());
+    }
+
+    if (loaded.size() != numTaps)
+        return juce::Result::fail ("The preset is cut short");
+
+    auto result = loaded.checkTaps();
+
+    if (result.wasOk())
+        *this = std::move (loaded);
+
+    return result;
+}
+
+//==============================================================================
+juce::ValueTree TapPattern::toValueTree() const
+{
+    juce::ValueTree tree (TapPatternIDs::pattern);
+    tree.setProperty (TapPatternIDs::name, name, nullptr);
+    tree.setProperty (TapPatternIDs::feedback, feedback, nullptr);
+
+    for (int i = 0; i < size(); ++i)
+    {
+        juce::ValueTree tap (TapPatternIDs::tap);
+        tap.setProperty (TapPatternIDs::timeMS, delayTimesMS[i], nullptr);
+        tap.setProperty (TapPatternIDs::gain, delayGains[i], nullptr);
+        tree.appendChild (tap, nullptr);
+    }
+
+    return tree;
+}
+
+juce::Result TapPattern::fromValueTree (const juce::ValueTree& tree)
+{
+    if (! tree.hasType (TapPatternIDs::pattern))
+        return juce::Result::fail ("Not a tap preset");
+
+    TapPattern loaded;
+    loaded.name = tree[TapPatternIDs::name].toString();
+    loaded.feedback = (float) tree[TapPatternIDs::feedback];
+
+    for (const auto& tap : tree)
+    {
+        if (tap.hasType (TapPatternIDs::tap))
+        {
+            loaded.delayTimesMS.add ((float) tap[TapPatternIDs::timeMS]);
+            loaded.delayGains.add ((float) tap[TapPatternIDs::gain]);
+        }
+    }
+
+    auto result = loaded.checkTaps();
+
+    if (result.wasOk())
+        *this = std::move (loaded);
+
+    return result;
+}
+
+//==============================================================================
+juce::Result TapPattern::saveToFile (const juce::File& file) const
+{
+    if (file.hasFileExtension (xmlFileExtension))
+    {
+        if (auto xml = toValueTree().createXml())
+            if (xml->writeTo (file))
+                return juce::Result::ok();
+
+        return juce::Result::fail ("Couldn't write to " + file.getFullPathName());
+    }
+
+    // Write the whole preset to memory first, so a failed save never leaves half a file behind
+    juce::MemoryOutputStream data;
+    writeTo (data);
+
+    if (! file.replaceWithData (data.getData(), data.getDataSize()))
+        return juce::Result::fail ("Couldn't write to " + file.getFullPathName());
+
+    return juce::Result::ok();
+}
+
+juce::Result TapPattern::loadFromFile (const juce::File& file)
+{
+    auto result = juce::Result::fail ("Couldn't read " + file.getFullPathName());
+
+    if (file.hasFileExtension (xmlFileExtension))
+    {
+        if (auto xml = juce::parseXML (file))
+            result = fromValueTree (juce::ValueTree::fromXml (*xml));
+    }
+    else
+    {
+        juce::FileInputStream in (file);
+
+        if (in.openedOk())
+            result = readFrom (in);
+    }
+
+    if (result.wasOk() && name.isEmpty())
+        name = file.getFileNameWithoutExtension();
+
+    return result;
+}
+
+juce::Result TapPattern::checkTaps() const
+{
+    const float maximumDelayTimeMS = DelayEngine::maximumDelayTimeS * 1000.0f;
+
+    for (int i = 0; i < size(); ++i)
+        if (! (delayTimesMS[i] >= 0.0f && delayTimesMS[i] <= maximumDelayTimeMS) || ! std::isfinite (delayGains[i]))
+            return juce::Result::fail ("The preset has a tap out of range");
+
+    if (! std::isfinite (feedback) || feedback < 0.0f || feedback > TapTable::maximumFeedback)
+        return juce::Result::fail ("The preset's feedback is out of range");
+
+    return juce::Result::ok();
+}
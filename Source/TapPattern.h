@@ -0,0 +1,43 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/*
+    A drawn set of taps that can be saved and loaded again - the same times, gains
+    and feedback amount the engine is given, plus a name.
+
+    Presets are normally stored in a compact binary form (see writeTo()), a few
+    bytes per tap. They can also be exported as a ValueTree, and so as XML, for
+    reading or editing by hand. loadFromFile() takes either.
+*/
+struct TapPattern
+{
+    juce::String name;
+    juce::Array<float> delayTimesMS;
+    juce::Array<float> delayGains;
+    float feedback = 0.0f;
+
+    int size() const noexcept    { return delayTimesMS.size(); }
+
+    //==============================================================================
+    /** The binary format: magic, version, name, feedback, tap count, then each tap's time and gain. */
+    void writeTo (juce::OutputStream& out) const;
+    juce::Result readFrom (juce::InputStream& in);
+
+    juce::ValueTree toValueTree() const;
+    juce::Result fromValueTree (const juce::ValueTree& tree);
+
+    /** Files ending in xmlFileExtension are written as XML, anything else in the binary format. */
+    juce::Result saveToFile (const juce::File& file) const;
+    juce::Result loadFromFile (const juce::File& file);
+
+    static constexpr const char* binaryFileExtension = ".ddtaps";
+    static constexpr const char* xmlFileExtension = ".xml";
+
+private:
+    juce::Result checkTaps() const;
+
+    static constexpr int magic = 0x70546444; // "DdTp" when written little-endian
+    static constexpr int version = 2; // 1 stored whole milliseconds
+};